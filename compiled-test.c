@@ -0,0 +1,184 @@
+// Build command: gcc -O2 compiled-test.c dictionary.c iniparser.c -o compiled-test -lpthread
+
+/* Regression tests for iniparser_load_compiled: the cache must be used
+ * while its source is unchanged, and compiled again as soon as the
+ * source differs in contents, size, modification time or inode, or the
+ * cache itself is damaged. Keys of any length are looked up regardless
+ * of case, both in a freshly compiled file and in a mapped cache.
+ *
+ * Sources get modification times in the past, so that a cache written
+ * right after them is newer even on coarse timestamps.
+ *
+ * Prints one line per failing check; the exit status is the number of
+ * failures. */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "iniparser.h"
+
+#define LONG_KEY 3000           /* Key longer than any parser buffer */
+
+static char ini[64];
+static char cache[80];
+static char other[80];
+
+static int
+set_mtime (const char *path, time_t mtime)
+{
+  struct timespec ts[2];
+
+  ts[0].tv_sec = ts[1].tv_sec = mtime;
+  ts[0].tv_nsec = ts[1].tv_nsec = 0;
+  return utimensat (AT_FDCWD, path, ts, 0);
+}
+
+/* Writes text to path, which gets mtime as modification time */
+static int
+write_file (const char *path, const char *text, time_t mtime)
+{
+  FILE *f = fopen (path, "w");
+
+  if (!f)
+    return -1;
+  fputs (text, f);
+  if (fclose (f))
+    return -1;
+  return set_mtime (path, mtime);
+}
+
+static ino_t
+cache_ino (void)
+{
+  struct stat st;
+
+  return stat (cache, &st) ? 0 : st.st_ino;
+}
+
+/* Loads ini through cache and checks the value of key, and whether the
+ * cache file was kept or written again */
+static int
+check (const char *what, const char *key, const char *expect, int rebuilt)
+{
+  ino_t before = cache_ino ();
+  iniparser_compiled_t *c = iniparser_load_compiled (ini, cache);
+  const char *val = iniparser_compiled_getstring (c, key, "(none)");
+  int failed = 0;
+
+  if (!c) {
+    printf ("%s: cannot load\n", what);
+    return 1;
+  }
+  if (!val || strcmp (val, expect)) {
+    printf ("%s: got \"%s\", expected \"%s\"\n", what, val ? val : "",
+            expect);
+    failed = 1;
+  }
+  if ((cache_ino () != before) != rebuilt) {
+    printf ("%s: cache %s\n", what, rebuilt ? "reused" : "compiled again");
+    failed = 1;
+  }
+  iniparser_compiled_free (c);
+  return failed;
+}
+
+/* Contents with a key of LONG_KEY mixed case characters */
+static char *
+long_text (char *key)
+{
+  static char text[LONG_KEY + 64];
+  int i;
+
+  for (i = 0; i < LONG_KEY; i++)
+    key[i] = "aBcDeFgH"[i % 8];
+  key[LONG_KEY] = '\0';
+  snprintf (text, sizeof text, "[Sec]\n%s = 42\n", key);
+  return text;
+}
+
+static int
+check_long (const char *what, const char *key)
+{
+  char folded[LONG_KEY + 8];
+  iniparser_compiled_t *c = iniparser_load_compiled (ini, cache);
+  int failed = 0;
+  size_t i;
+
+  snprintf (folded, sizeof folded, "sec:%s", key);
+  for (i = 0; folded[i]; i++)
+    if (i % 3 == 0)
+      folded[i] ^= 0x20 * (folded[i] != ':');
+  if (iniparser_compiled_getint (c, folded, -1) != 42) {
+    printf ("%s: long key not found with its case changed\n", what);
+    failed = 1;
+  }
+  folded[strlen (folded) - 1] = '0';
+  if (iniparser_compiled_getint (c, folded, -1) != -1) {
+    printf ("%s: long key found with a different last character\n", what);
+    failed = 1;
+  }
+  iniparser_compiled_free (c);
+  return failed;
+}
+
+int
+main (void)
+{
+  time_t t = time (NULL) - 3600;
+  char key[LONG_KEY + 1];
+  int failed = 0;
+  int fd;
+
+  strcpy (ini, "/tmp/compiled-test-XXXXXX");
+  if ((fd = mkstemp (ini)) < 0) {
+    perror ("mkstemp");
+    return 1;
+  }
+  close (fd);
+  snprintf (cache, sizeof cache, "%s.cache", ini);
+  snprintf (other, sizeof other, "%s.new", ini);
+  unlink (cache);
+
+  write_file (ini, "[a]\nk = one\n", t);
+  failed += check ("first load", "a:k", "one", 1);
+  failed += check ("unchanged", "A:K", "one", 0);
+
+  /* Same size and inode, only the modification time tells */
+  write_file (ini, "[a]\nk = two\n", t + 1);
+  failed += check ("contents and mtime changed", "a:k", "two", 1);
+  failed += check ("unchanged again", "a:k", "two", 0);
+
+  /* Same size and modification time, only the inode tells */
+  write_file (other, "[a]\nk = six\n", t + 1);
+  rename (other, ini);
+  failed += check ("file replaced", "a:k", "six", 1);
+
+  write_file (ini, "[a]\nk = seven\n", t + 2);
+  failed += check ("size changed", "a:k", "seven", 1);
+
+  /* The source may have changed again within the resolution of its
+   * timestamp, a cache not newer than it is compiled again */
+  set_mtime (cache, t + 2);
+  failed += check ("cache as old as its source", "a:k", "seven", 1);
+  failed += check ("cache newer than its source", "a:k", "seven", 0);
+
+  write_file (ini, "[a]\nk = nine\n", t + 3);
+  failed += check ("source rewritten", "a:k", "nine", 1);
+  write_file (cache, "garbage", time (NULL) + 2);
+  failed += check ("damaged cache", "a:k", "nine", 1);
+  failed += check ("repaired cache", "a:k", "nine", 0);
+
+  write_file (ini, long_text (key), t + 4);
+  failed += check_long ("long key, compiled", key);
+  failed += check_long ("long key, mapped", key);
+
+  unlink (other);
+  unlink (cache);
+  unlink (ini);
+  return failed;
+}
@@ -19,6 +19,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <stdatomic.h>
 
 /** Maximum value size for integers and doubles. */
 #define MAXVALSZ    1024
@@ -26,9 +28,330 @@
 /** Minimal allocated number of entries in a dictionary */
 #define DICTMINSZ   128
 
+/** Size of the first arena chunk, later chunks double up to DICT_CHUNKMAX */
+#define DICT_CHUNKMIN   (16 * 1024)
+#define DICT_CHUNKMAX   (1024 * 1024)
+
+/** Arena strings take a multiple of DICT_ARENA_ALIGN bytes, longer ones
+    than DICT_ARENA_MAX are left to malloc() */
+#define DICT_ARENA_ALIGN    8
+#define DICT_ARENA_MAX      256
+#define DICT_ARENA_CLASSES  (DICT_ARENA_MAX / DICT_ARENA_ALIGN)
+
+/** Slot arrays shrink by half once at most 1/DICT_SHRINK_RATIO used */
+#define DICT_SHRINK_RATIO   4
+
+/** Index shrinks by half once at most 1/DICT_ISHRINK_RATIO loaded */
+#define DICT_ISHRINK_RATIO  16
+
+/** Number of deleted slots always tolerated before compacting entries */
+#define DICT_HOLES_MIN      16
+
+/** Number of slots copied or packed by each insertion while the slot
+    arrays grow or are compacted */
+#define DICT_SLOT_STEP      16
+
+/** typed[] and sect[] are allocated DICT_SEG_SIZE slots at a time */
+#define DICT_SEG_SHIFT      7
+#define DICT_SEG_SIZE       ((size_t)1 << DICT_SEG_SHIFT)
+
+/** Number of old index buckets migrated by each dictionary update */
+#define DICT_MIGRATE_STEP   16
+
+/** Free and deleted buckets of the orphan table */
+#define DICT_ORPHANS_FREE       (-1)
+#define DICT_ORPHANS_DELETED    (-2)
+/** Smallest number of buckets of the orphan table */
+#define DICT_ORPHANS_MIN        16
+
 /** Invalid key token */
 #define DICT_INVALID_KEY    ((char*)-1)
 
+/** Average number of keys per bucket in a frozen dictionary */
+#define DICT_FROZEN_LAMBDA  4
+/** Seeds tried per bucket, and key hash seeds tried, before giving up */
+#define DICT_FROZEN_SEEDS   (1u << 24)
+#define DICT_FROZEN_TRIES   16
+/** Value offset of keys without value in a frozen dictionary */
+#define DICT_FROZEN_NULL    0xFFFFFFFFu
+/** Tag of frozen dictionary blocks, to change with their layout or hash */
+#define DICT_FROZEN_MAGIC   0x325A5246u
+
+#define DICT_GOLDEN         0x9E3779B97F4A7C15ULL
+
+/** Byte masks used to fold ASCII upper case letters in 8 bytes at once */
+#define DICT_BYTES_LO       0x0101010101010101ULL
+#define DICT_BYTES_HI       0x8080808080808080ULL
+
+/** Odd constants with balanced bits, mixed into keys by dictionary_hash */
+#define DICT_HASH_P0        0xA0761D6478BD642FULL
+#define DICT_HASH_P1        0xE7037ED1A0B428DBULL
+#define DICT_HASH_P2        0x8EBC6AF09C88C6E3ULL
+#define DICT_HASH_P3        0x589965CC75374CC3ULL
+
+/*
+ * Index control bytes. A bucket in use holds the 7 top bits of the hash
+ * of its key, free buckets have the high bit set.
+ */
+#define DICT_CTRL_EMPTY     0x80
+#define DICT_CTRL_DELETED   0xFE
+#define DICT_CTRL_TAG(h)    ((unsigned char)((h) >> 25))
+
+/*
+ * Control bytes are matched one group at a time. A group match returns a
+ * bitmask where each matching byte sets DICT_GROUP_STRIDE bits, the lowest
+ * one at position byte * DICT_GROUP_STRIDE.
+ */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define DICT_GROUP_WIDTH    32
+#define DICT_GROUP_STRIDE   1
+typedef unsigned dict_mask ;
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define DICT_GROUP_WIDTH    16
+#define DICT_GROUP_STRIDE   1
+typedef unsigned dict_mask ;
+#else
+#define DICT_GROUP_WIDTH    8
+#define DICT_GROUP_STRIDE   8
+typedef uint64_t dict_mask ;
+#define DICT_LSB            0x0101010101010101ULL
+#define DICT_MSB            0x8080808080808080ULL
+#endif
+
+/*---------------------------------------------------------------------------
+                                Private types
+ ---------------------------------------------------------------------------*/
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Arena chunk
+
+  Chunks are chained from the most recent one. String bytes are stored
+  right after the chunk header.
+ */
+/*-------------------------------------------------------------------------*/
+typedef struct _dict_chunk_ {
+    struct _dict_chunk_ *   next ;  /** Previously allocated chunk */
+    size_t                  size ;  /** Number of bytes for strings */
+    size_t                  used ;  /** Number of bytes handed out */
+} dict_chunk ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Lookup index
+
+  Open-addressing table of size buckets (always a power of 2) laid out
+  as a swiss table: slot[] holds the slot number each bucket points to,
+  and ctrl[] holds one control byte per bucket so that a whole group of
+  buckets can be matched against a hash tag at once. Only buckets whose
+  tag matches are checked against the full hash and the key. The first
+  DICT_GROUP_WIDTH control bytes are mirrored after the end of ctrl[] so
+  that groups never need to wrap. slot[] and ctrl[] share a single
+  allocation, owned by slot.
+ */
+/*-------------------------------------------------------------------------*/
+typedef struct _dict_index_ {
+    size_t          size ;   /** Number of buckets */
+    size_t          used ;   /** Buckets either in use or deleted */
+    unsigned    *   slot ;   /** Slot number for each bucket */
+    unsigned char * ctrl ;   /** Control byte for each bucket */
+} dict_index ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Converted forms of a value
+
+  Cache of the conversions of the value in the same slot, each valid
+  once its DICT_TYPED_* bit is set in flags. Readers of a dictionary fill
+  it concurrently: a field is stored before its bit is set with release
+  order, and only read after the bit is seen with acquire order. Readers
+  converting the same value store the same result.
+ */
+/*-------------------------------------------------------------------------*/
+typedef struct _dict_typed_ {
+    _Atomic long int        l ;      /** Value converted by strtol() */
+    _Atomic double          f ;      /** Value converted by atof() */
+    _Atomic signed char     b ;      /** Value as a boolean, -1 if not one */
+    _Atomic unsigned char   flags ;  /** DICT_TYPED_* bits of valid fields */
+} dict_typed ;
+
+#define DICT_TYPED_LONG     0x01
+#define DICT_TYPED_DOUBLE   0x02
+#define DICT_TYPED_BOOL     0x04
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Section links of a slot
+
+  Sections are the keys without a colon, and the section of any other
+  key is the part of it before the first colon. Sections are chained in
+  slot order through prev and next, and so are the keys of each section,
+  from first to last. Keys whose section is not in the dictionary are
+  orphans, chained in slot order with the other orphans of the same
+  section name until their section shows up. All links are slot
+  numbers, -1 ending a chain. Keys do not link to their section, which
+  is looked up instead, so that a section moves without its keys.
+ */
+/*-------------------------------------------------------------------------*/
+typedef struct _dict_sect_ {
+    int32_t         prev ;   /** Previous key or section in its chain */
+    int32_t         next ;   /** Next key or section in its chain */
+    int32_t         first ;  /** First key of a section */
+    int32_t         last ;   /** Last key of a section */
+    int32_t         count ;  /** Number of keys of a section */
+} dict_sect ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Orphans of a section name
+
+  Bucket of the open-addressing table which finds the orphan chain of a
+  section name, so that a new section takes over its keys without
+  looking at the other orphans. The name is the part before the colon
+  of the first key of the chain.
+ */
+/*-------------------------------------------------------------------------*/
+typedef struct _dict_orphans_ {
+    unsigned        hash ;   /** Hash of the section name */
+    int32_t         first ;  /** First key, or DICT_ORPHANS_FREE/DELETED */
+    int32_t         last ;   /** Last key */
+} dict_orphans ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Dictionary object with its private lookup index
+
+  The public dictionary structure only describes the key/val/hash slot
+  arrays. Lookups go through idx, which is kept at most 3/4 full,
+  counting deleted buckets, so that probe sequences stay short.
+
+  Resizing the index does not rehash everything at once. The current
+  index becomes old and a new empty one takes its place: new keys only
+  go to the new index, lookups try both, and every update migrates the
+  next DICT_MIGRATE_STEP old buckets until old can be released.
+
+  When created with DICTIONARY_ARENA, key and value strings are carved
+  out of a list of chunks instead of being allocated one by one. Bytes
+  of overwritten or deleted strings are kept on afree[], one list per
+  size, for the next strings of the same size, and given back to the
+  system by dictionary_compact(). Updates never move other strings,
+  which callers may still be pointing to.
+
+  Slot arrays do not grow in one go either. Once they are 3/4 used,
+  arrays twice as large are allocated beside them and every insertion
+  copies the next DICT_SLOT_STEP slots, slots already copied being
+  written to both; the larger arrays take over once all used slots are
+  copied. Deleted slots are removed the same way: psrc walks up the
+  slots and each insertion moves the next entries down to pdst.
+
+  typed[] runs parallel to the slot arrays and caches numeric and
+  boolean conversions of values. It is allocated by insertions, never
+  by lookups, and dropped rather than reported if it cannot grow.
+
+  With DICTIONARY_SECTIONS, sect[] also runs parallel to the slot arrays
+  and links keys to their sections, so that sections can be listed and
+  dumped without scanning the whole dictionary. It is dropped the same
+  way as typed[], section queries then reporting that there is no index,
+  and so is it if the orphan table cannot grow.
+
+  Both are split in segments of DICT_SEG_SIZE slots, allocated as the
+  slots get used, so that they never have to be copied. Their segment
+  tables have nseg entries.
+
+  Values lying within the storage lent by dictionary_borrow() are stored
+  as is: they are neither copied, nor accounted for in the arena, nor
+  freed with the dictionary, which hands the storage back instead.
+ */
+/*-------------------------------------------------------------------------*/
+typedef struct _dictionary_impl_ {
+    dictionary      pub ;    /** Public part, must come first */
+    unsigned        flags ;  /** DICTIONARY_* creation flags */
+    dictionary_hash_fn  hashfn ; /** Hash function of keys */
+    dict_index      idx ;    /** Lookup index */
+    dict_index      old ;    /** Index being migrated to idx, if any */
+    size_t          omig ;   /** Number of old buckets migrated so far */
+    dict_chunk  *   chunks ; /** Arena chunks, most recent first */
+    size_t          alive ;  /** Arena bytes used by live strings */
+    size_t          adead ;  /** Arena bytes used by released strings */
+    char        *   afree[DICT_ARENA_CLASSES] ; /** Released strings by size */
+    size_t          abig ;   /** Strings too long for the arena */
+    size_t          grows ;  /** Number of times slots or index grew */
+    size_t          shrinks ; /** Number of times slots or index shrank */
+    size_t          gets ;   /** dictionary_get() calls, if counted */
+    size_t          misses ; /** dictionary_get() misses, if counted */
+    size_t          sets ;   /** dictionary_set() calls, if counted */
+    char        **  gval ;   /** Values of the arrays being grown to */
+    char        **  gkey ;   /** Keys of the arrays being grown to */
+    unsigned    *   ghash ;  /** Hashes of the arrays being grown to */
+    ssize_t         gsize ;  /** Size of the arrays being grown to, or 0 */
+    ssize_t         gcopy ;  /** Slots already copied to them */
+    ssize_t         pdst ;   /** Slot the next entry is packed to, or -1 */
+    ssize_t         psrc ;   /** Next slot looked at by packing */
+    dict_typed  **  typed ;  /** Conversion cache segments, or NULL */
+    dict_sect   **  sect ;   /** Section link segments, or NULL */
+    size_t          nseg ;   /** Number of segments in typed and sect */
+    ssize_t         sfirst ; /** First section slot, or -1 */
+    ssize_t         slast ;  /** Last section slot, or -1 */
+    dict_orphans *  orph ;   /** Orphan chains by section name, or NULL */
+    size_t          osize ;  /** Number of orphan buckets, a power of 2 */
+    size_t          oused ;  /** Orphan buckets in use or deleted */
+    size_t          ogroups ; /** Orphan buckets in use */
+    int             nsec ;   /** Number of sections */
+    ssize_t         slook ;  /** Section last found for a key, or -1 */
+    char        *   bbase ;  /** Start of borrowed storage, or NULL */
+    size_t          blen ;   /** Size of borrowed storage */
+    dictionary_release_fn brelease ; /** Hands borrowed storage back */
+} dictionary_impl ;
+
+#define DICT_IMPL(d)    ((dictionary_impl *)(d))
+
+/* Cache entry and section links of slot i */
+#define DICT_TYPED(d, i) \
+    (&(d)->typed[(size_t)(i) >> DICT_SEG_SHIFT][(size_t)(i) & (DICT_SEG_SIZE - 1)])
+#define DICT_SECT(d, i) \
+    (&(d)->sect[(size_t)(i) >> DICT_SEG_SHIFT][(size_t)(i) & (DICT_SEG_SIZE - 1)])
+
+/*
+ * Access counters, compiled in with -DDICTIONARY_COUNTERS. They are plain
+ * increments: concurrent readers of a dictionary may lose some counts.
+ */
+#ifdef DICTIONARY_COUNTERS
+#define DICT_COUNT(d, field)    (((dictionary_impl *)(d))->field ++)
+#else
+#define DICT_COUNT(d, field)    ((void)0)
+#endif
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Frozen dictionary
+
+  A frozen dictionary is one block holding this header, then one seed
+  per bucket, then one dict_frozen_entry per key, then key and value
+  strings. Entries refer to strings by their offset from the start of
+  the block, so the block does not depend on where it is loaded. The
+  magic number tells blocks of another layout, hash or byte order.
+  Copies of DICTIONARY_NOCASE dictionaries keep that flag, their keys
+  being in lower case, and fold the keys they look for.
+ */
+/*-------------------------------------------------------------------------*/
+struct _dictionary_frozen_ {
+    uint32_t        size ;   /** Size of the whole block in bytes */
+    uint32_t        n ;      /** Number of entries */
+    uint32_t        nb ;     /** Number of buckets */
+    uint32_t        magic ;  /** DICT_FROZEN_MAGIC */
+    uint64_t        seed ;   /** Seed of the key hash */
+    uint32_t        flags ;  /** DICTIONARY_NOCASE or 0 */
+    uint32_t        pad ;    /** Keeps the seeds 8-byte aligned, 0 */
+} ;
+
+typedef struct _dict_frozen_entry_ {
+    uint32_t        hash ;   /** Low 32 bits of the key hash */
+    uint32_t        key ;    /** Offset of the key string */
+    uint32_t        val ;    /** Offset of the value, or DICT_FROZEN_NULL */
+} dict_frozen_entry ;
+
 /*---------------------------------------------------------------------------
                             Private functions
  ---------------------------------------------------------------------------*/
@@ -60,170 +383,2057 @@ static char * xstrdup(const char * s)
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief    Double the size of the dictionary
-  @param    d Dictionary to grow
+  @brief    Tell whether a string lies within borrowed storage
+  @param    d   Dictionary to check
+  @param    s   String to check, may be NULL
+  @return   1 if s belongs to the storage lent by dictionary_borrow(), 0 if not
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_borrowed(const dictionary_impl * d, const char * s)
+{
+    return d->bbase!=NULL &&
+           (uintptr_t)s >= (uintptr_t)d->bbase &&
+           (uintptr_t)s <  (uintptr_t)d->bbase + d->blen ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Number of arena bytes taken by a string
+  @param    len  Length of the string, terminating zero included
+  @return   len rounded up to DICT_ARENA_ALIGN
+ */
+/*--------------------------------------------------------------------------*/
+static size_t dictionary_arena_size(size_t len)
+{
+    return (len + DICT_ARENA_ALIGN - 1) & ~(size_t)(DICT_ARENA_ALIGN - 1) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Allocate bytes from the arena of a dictionary
+  @param    d    Dictionary in arena mode
+  @param    len  Number of bytes to allocate
+  @return   Pointer to the bytes, or NULL if allocation failed
+
+  Bytes released by a string of the same size are reused first. A new
+  chunk is started when the current one is too small, chunk sizes
+  doubling from DICT_CHUNKMIN to DICT_CHUNKMAX. Strings longer than
+  DICT_ARENA_MAX are allocated with malloc() instead.
+ */
+/*--------------------------------------------------------------------------*/
+static char * dictionary_arena_alloc(dictionary_impl * d, size_t len)
+{
+    dict_chunk  *   c = d->chunks ;
+    char        **  head ;
+    char        *   t ;
+    size_t          size ;
+
+    len = dictionary_arena_size(len) ;
+    if (len > DICT_ARENA_MAX) {
+        t = (char*) malloc(len);
+        if (t)
+            d->abig ++ ;
+        return t ;
+    }
+    head = &d->afree[len / DICT_ARENA_ALIGN - 1] ;
+    if (*head) {
+        /* Released strings are chained through their first bytes */
+        t = *head ;
+        memcpy(head, t, sizeof *head);
+        d->adead -= len ;
+        d->alive += len ;
+        return t ;
+    }
+    if (c==NULL || c->size - c->used < len) {
+        size = c ? c->size * 2 : DICT_CHUNKMIN ;
+        if (size < DICT_CHUNKMIN)
+            size = DICT_CHUNKMIN ;
+        if (size > DICT_CHUNKMAX)
+            size = DICT_CHUNKMAX ;
+        c = (dict_chunk*) malloc(sizeof *c + size);
+        if (!c)
+            return NULL ;
+        c->size = size ;
+        c->used = 0 ;
+        c->next = d->chunks ;
+        d->chunks = c ;
+    }
+    c->used += len ;
+    d->alive += len ;
+    return (char*)(c + 1) + c->used - len ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Free all arena chunks of a dictionary
+  @param    c   Most recent chunk
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_arena_free(dict_chunk * c)
+{
+    dict_chunk * next ;
+
+    for ( ; c ; c = next) {
+        next = c->next ;
+        free(c);
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Free the strings of a dictionary too long for its arena
+  @param    d   Dictionary in arena mode
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_arena_free_big(dictionary_impl * d)
+{
+    ssize_t i ;
+
+    for (i=0 ; i<d->pub.used && d->abig>0 ; i++) {
+        if (d->pub.key[i]==NULL)
+            continue ;
+        if (strlen(d->pub.key[i]) >= DICT_ARENA_MAX) {
+            free(d->pub.key[i]);
+            d->abig -- ;
+        }
+        if (d->pub.val[i]!=NULL && !dictionary_borrowed(d, d->pub.val[i]) &&
+            strlen(d->pub.val[i]) >= DICT_ARENA_MAX) {
+            free(d->pub.val[i]);
+            d->abig -- ;
+        }
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Move all live strings of a dictionary to a single fresh chunk
+  @param    d   Dictionary in arena mode
   @return   This function returns non-zero in case of failure
+
+  Strings too long for the arena stay where they are. On failure the
+  dictionary is left untouched.
  */
 /*--------------------------------------------------------------------------*/
-static int dictionary_grow(dictionary * d)
+static int dictionary_arena_compact(dictionary_impl * d)
 {
-    char        ** new_val ;
-    char        ** new_key ;
-    unsigned     * new_hash ;
+    dict_chunk  *   c ;
+    char        *   t ;
+    size_t          len ;
+    ssize_t         i ;
 
-    new_val  = (char**) calloc(d->size * 2, sizeof *d->val);
-    new_key  = (char**) calloc(d->size * 2, sizeof *d->key);
-    new_hash = (unsigned*) calloc(d->size * 2, sizeof *d->hash);
-    if (!new_val || !new_key || !new_hash) {
-        /* An allocation failed, leave the dictionary unchanged */
-        if (new_val)
-            free(new_val);
-        if (new_key)
-            free(new_key);
-        if (new_hash)
-            free(new_hash);
+    c = (dict_chunk*) malloc(sizeof *c + d->alive);
+    if (!c)
         return -1 ;
+    c->next = NULL ;
+    c->size = d->alive ;
+    t = (char*)(c + 1) ;
+    for (i=0 ; i<d->pub.used ; i++) {
+        if (d->pub.key[i]==NULL)
+            continue ;
+        len = strlen(d->pub.key[i]) + 1 ;
+        if (len <= DICT_ARENA_MAX) {
+            memcpy(t, d->pub.key[i], len);
+            d->pub.key[i] = t ;
+            t += dictionary_arena_size(len) ;
+        }
+        if (d->pub.val[i]==NULL || dictionary_borrowed(d, d->pub.val[i]))
+            continue ;
+        len = strlen(d->pub.val[i]) + 1 ;
+        if (len <= DICT_ARENA_MAX) {
+            memcpy(t, d->pub.val[i], len);
+            d->pub.val[i] = t ;
+            t += dictionary_arena_size(len) ;
+        }
     }
-    /* Initialize the newly allocated space */
-    memcpy(new_val, d->val, d->size * sizeof(char *));
-    memcpy(new_key, d->key, d->size * sizeof(char *));
-    memcpy(new_hash, d->hash, d->size * sizeof(unsigned));
-    /* Delete previous data */
-    free(d->val);
-    free(d->key);
-    free(d->hash);
-    /* Actually update the dictionary */
-    d->size *= 2 ;
-    d->val = new_val;
-    d->key = new_key;
-    d->hash = new_hash;
+    c->used = (size_t)(t - (char*)(c + 1)) ;
+    dictionary_arena_free(d->chunks);
+    d->chunks = c ;
+    d->adead  = 0 ;
+    memset(d->afree, 0, sizeof d->afree);
     return 0 ;
 }
 
-/*---------------------------------------------------------------------------
-                            Function codes
- ---------------------------------------------------------------------------*/
 /*-------------------------------------------------------------------------*/
 /**
-  @brief    Compute the hash key for a string.
-  @param    key     Character string to use for key.
-  @return   1 unsigned int on at least 32 bits.
+  @brief    Duplicate a string into the storage of a dictionary
+  @param    d   Dictionary which will own the copy
+  @param    s   String to duplicate
+  @return   Pointer to the copy, NULL if s is NULL or allocation failed
+ */
+/*--------------------------------------------------------------------------*/
+static char * dictionary_strdup(dictionary_impl * d, const char * s)
+{
+    char * t ;
+    size_t len ;
 
-  This hash function has been taken from an Article in Dr Dobbs Journal.
-  This is normally a collision-free function, distributing keys evenly.
-  The key is stored anyway in the struct so that collision can be avoided
-  by comparing the key itself in last resort.
+    if (!(d->flags & DICTIONARY_ARENA))
+        return xstrdup(s);
+    if (!s)
+        return NULL ;
+
+    len = strlen(s) + 1 ;
+    t = dictionary_arena_alloc(d, len);
+    if (t) {
+        memcpy(t, s, len) ;
+    }
+    return t ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Release a string owned by a dictionary
+  @param    d   Dictionary owning the string
+  @param    s   String to release, may be NULL
+  @return   void
+
+  In arena mode the bytes are kept for the next string of the same size,
+  and only given back to the system by dictionary_compact().
  */
 /*--------------------------------------------------------------------------*/
-unsigned dictionary_hash(const char * key)
+static void dictionary_strfree(dictionary_impl * d, char * s)
 {
-    size_t      len ;
-    unsigned    hash ;
-    size_t      i ;
+    char ** head ;
+    size_t  len ;
 
-    if (!key)
-        return 0 ;
+    if (!s || dictionary_borrowed(d, s))
+        return ;
+    if (!(d->flags & DICTIONARY_ARENA)) {
+        free(s);
+        return ;
+    }
+    len = dictionary_arena_size(strlen(s) + 1) ;
+    if (len > DICT_ARENA_MAX) {
+        free(s);
+        d->abig -- ;
+        return ;
+    }
+    head = &d->afree[len / DICT_ARENA_ALIGN - 1] ;
+    memcpy(s, head, sizeof *head);
+    *head = s ;
+    d->alive -= len ;
+    d->adead += len ;
+}
 
-    len = strlen(key);
-    for (hash=0, i=0 ; i<len ; i++) {
-        hash += (unsigned)key[i] ;
-        hash += (hash<<10);
-        hash ^= (hash>>6) ;
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Forget the conversions cached for a slot
+  @param    d   Dictionary being modified
+  @param    i   Slot whose value changed
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_typed_reset(dictionary_impl * d, ssize_t i)
+{
+    if (d->typed)
+        atomic_store_explicit(&DICT_TYPED(d, i)->flags, 0, memory_order_relaxed);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Release the conversion cache of a dictionary
+  @param    d   Dictionary to modify
+  @return   void
+
+  Conversions are then done again on every call.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_typed_drop(dictionary_impl * d)
+{
+    size_t s ;
+
+    for (s=0 ; d->typed && s<d->nseg ; s++)
+        free(d->typed[s]);
+    free(d->typed);
+    d->typed = NULL ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Store an entry in a slot
+  @param    d     Dictionary to modify
+  @param    i     Slot number
+  @param    key   Key, NULL for a deleted slot
+  @param    val   Value
+  @param    hash  Hash of key, 0 for a deleted slot
+  @return   void
+
+  Slots already copied to the arrays being grown to are updated there too.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_slot_set(dictionary_impl * d, ssize_t i, char * key, char * val, unsigned hash)
+{
+    d->pub.key[i]  = key ;
+    d->pub.val[i]  = val ;
+    d->pub.hash[i] = hash ;
+    if (i < d->gcopy) {
+        d->gkey[i]  = key ;
+        d->gval[i]  = val ;
+        d->ghash[i] = hash ;
     }
-    hash += (hash <<3);
-    hash ^= (hash >>11);
-    hash += (hash <<15);
-    return hash ;
 }
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief    Create a new dictionary object.
-  @param    size    Optional initial size of the dictionary.
-  @return   1 newly allocated dictionary objet.
+  @brief    Scramble the bits of a 64-bit integer
+  @param    x   Value to scramble
+  @return   Scrambled value
+
+  This is the splitmix64 finalizer: every input bit affects every output
+  bit.
+ */
+/*--------------------------------------------------------------------------*/
+static uint64_t dictionary_mix64(uint64_t x)
+{
+    x ^= x >> 30 ;
+    x *= 0xBF58476D1CE4E5B9ULL ;
+    x ^= x >> 27 ;
+    x *= 0x94D049BB133111EBULL ;
+    x ^= x >> 31 ;
+    return x ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Convert the ASCII upper case letters of 8 bytes to lower case
+  @param    w   8 bytes of a string
+  @return   w with bytes 'A' to 'Z' replaced by 'a' to 'z'
+
+  Bytes are compared against 'A' and 'Z' in parallel on their low 7 bits,
+  bytes with the high bit set are left alone.
+ */
+/*--------------------------------------------------------------------------*/
+static uint64_t dictionary_fold64(uint64_t w)
+{
+    uint64_t    x = w & ~DICT_BYTES_HI ;
+    uint64_t    ge_a = x + DICT_BYTES_LO * (0x80 - 'A') ;
+    uint64_t    gt_z = x + DICT_BYTES_LO * (0x80 - 'Z' - 1) ;
+
+    return w | ((ge_a & ~gt_z & ~w & DICT_BYTES_HI) >> 2) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Convert an ASCII upper case letter to lower case
+  @param    c   Character to convert
+  @return   Lower case c, or c if it is not an ASCII upper case letter
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_fold(int c)
+{
+    return (c>='A' && c<='Z') ? c + ('a' - 'A') : c ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compare a key with a stored key
+  @param    flags Flags of the dictionary owning the stored key
+  @param    key   Key looked for
+  @param    skey  Key stored in the dictionary
+  @return   int   1 if the keys are equal, 0 otherwise
+
+  With DICTIONARY_NOCASE, stored keys are in lower case and the key
+  looked for is folded as it is compared.
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_keyeq(unsigned flags, const char * key, const char * skey)
+{
+    if (!(flags & DICTIONARY_NOCASE))
+        return !strcmp(key, skey) ;
+    for ( ; *skey ; key++, skey++) {
+        if (dictionary_fold((unsigned char)*key) != (unsigned char)*skey)
+            return 0 ;
+    }
+    return *key=='\0' ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Multiply two 64-bit words and fold the 128-bit product
+  @param    a   First word
+  @param    b   Second word
+  @return   High and low halves of a*b xored together
+ */
+/*--------------------------------------------------------------------------*/
+static uint64_t dictionary_mum(uint64_t a, uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t)a * b ;
+
+    return (uint64_t)r ^ (uint64_t)(r >> 64) ;
+#else
+    uint64_t    ha = a >> 32, la = (uint32_t)a ;
+    uint64_t    hb = b >> 32, lb = (uint32_t)b ;
+    uint64_t    hh = ha * hb, hl = ha * lb, lh = la * hb, ll = la * lb ;
+    uint64_t    mid = (ll >> 32) + (uint32_t)hl + (uint32_t)lh ;
+
+    return (hh + (hl >> 32) + (lh >> 32) + (mid >> 32)) ^
+           ((mid << 32) | (uint32_t)ll) ;
+#endif
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compute a seeded 64-bit hash for a string
+  @param    key     Character string to hash
+  @param    seed    Hash seed
+  @param    fold    Non-zero to hash ASCII letters in lower case
+  @return   64-bit hash value
+
+  Used by frozen dictionaries, which need hashes they can reseed.
+ */
+/*--------------------------------------------------------------------------*/
+static uint64_t dictionary_hash64(const char * key, uint64_t seed, int fold)
+{
+    size_t      len = strlen(key) ;
+    uint64_t    h = seed ^ (len * DICT_GOLDEN) ;
+    uint64_t    w ;
+
+    for ( ; len>=8 ; key+=8, len-=8) {
+        memcpy(&w, key, 8);
+        h = dictionary_mix64(h ^ (fold ? dictionary_fold64(w) : w));
+    }
+    w = 0 ;
+    memcpy(&w, key, len);
+    return dictionary_mix64(h ^ (fold ? dictionary_fold64(w) : w));
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Map a 32-bit hash to [0, n) without a division
+  @param    x   Hash value
+  @param    n   Size of the range
+  @return   Integer in [0, n)
+ */
+/*--------------------------------------------------------------------------*/
+static uint32_t dictionary_range(uint32_t x, uint32_t n)
+{
+    return (uint32_t)(((uint64_t)x * n) >> 32) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compute the slot of a key in a frozen dictionary
+  @param    h   Key hash
+  @param    s   Seed of the bucket of the key
+  @param    n   Number of entries
+  @return   Slot number in [0, n)
+ */
+/*--------------------------------------------------------------------------*/
+static uint32_t dictionary_frozen_slot(uint64_t h, uint32_t s, uint32_t n)
+{
+    return dictionary_range((uint32_t)(dictionary_mix64(h + s * DICT_GOLDEN) >> 32), n) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Match a group of control bytes against a value
+  @param    ctrl  First control byte of the group
+  @param    c     Control byte value to look for
+  @return   Bitmask of the matching bytes in the group
+
+  The portable version may report false positives above a true match,
+  callers always check the control byte of the buckets they visit.
+ */
+/*--------------------------------------------------------------------------*/
+static dict_mask dictionary_group_match(const unsigned char * ctrl, unsigned char c)
+{
+#if defined(__AVX2__)
+    __m256i g = _mm256_loadu_si256((const __m256i *)ctrl);
+    return (dict_mask)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(g, _mm256_set1_epi8((char)c)));
+#elif DICT_GROUP_WIDTH == 16
+    __m128i g = _mm_loadu_si128((const __m128i *)ctrl);
+    return (dict_mask)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(g, _mm_set1_epi8((char)c)));
+#else
+    dict_mask g ;
+
+    memcpy(&g, ctrl, sizeof g);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    g = __builtin_bswap64(g);
+#endif
+    g ^= DICT_LSB * c ;
+    return (g - DICT_LSB) & ~g & DICT_MSB ;
+#endif
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find the lowest byte set in a group bitmask
+  @param    m   Non-zero bitmask as returned by dictionary_group_match()
+  @return   Byte offset in the group
+ */
+/*--------------------------------------------------------------------------*/
+static unsigned dictionary_mask_first(dict_mask m)
+{
+#if defined(__GNUC__)
+    if (sizeof m > sizeof(unsigned))
+        return (unsigned)__builtin_ctzll(m) / DICT_GROUP_STRIDE ;
+    return (unsigned)__builtin_ctz((unsigned)m) / DICT_GROUP_STRIDE ;
+#else
+    unsigned n = 0 ;
+
+    while (!(m & 1)) {
+        m >>= 1 ;
+        n++ ;
+    }
+    return n / DICT_GROUP_STRIDE ;
+#endif
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set the control byte of an index bucket
+  @param    ix  Index to modify
+  @param    b   Bucket number
+  @param    c   New control byte
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_set_ctrl(dict_index * ix, size_t b, unsigned char c)
+{
+    ix->ctrl[b] = c ;
+    if (b < DICT_GROUP_WIDTH)
+        ix->ctrl[ix->size + b] = c ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compute the number of index buckets for a given storage size
+  @param    size  Number of slots in the dictionary
+  @return   Smallest power of 2 holding size slots at half load
+ */
+/*--------------------------------------------------------------------------*/
+static size_t dictionary_index_size(size_t size)
+{
+    size_t isize = DICTMINSZ ;
+
+    while (isize < size * 2)
+        isize *= 2 ;
+    return isize ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Allocate an empty index
+  @param    ix    Index to initialize
+  @param    size  Number of buckets, a power of 2
+  @return   This function returns non-zero in case of failure
+
+  On failure ix is left untouched.
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_index_alloc(dict_index * ix, size_t size)
+{
+    unsigned    *   slot ;
+
+    slot = (unsigned*) malloc(size * sizeof *slot + size + DICT_GROUP_WIDTH);
+    if (!slot)
+        return -1 ;
+    ix->slot = slot ;
+    ix->ctrl = (unsigned char *)(slot + size) ;
+    ix->size = size ;
+    ix->used = 0 ;
+    memset(ix->ctrl, DICT_CTRL_EMPTY, size + DICT_GROUP_WIDTH);
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find the index bucket pointing to a key
+  @param    d     Dictionary owning the index
+  @param    ix    Index to search
+  @param    key   Key to look for
+  @param    hash  Hash value of key
+  @return   Bucket number, or -1 if the key is not in the index
+
+  Buckets are visited one group at a time, starting with the group that
+  begins at hash & (size-1). The probe stops at the first group holding
+  an empty bucket.
+ */
+/*--------------------------------------------------------------------------*/
+static ssize_t dictionary_index_find(
+    const dictionary_impl * d,
+    const dict_index * ix,
+    const char * key,
+    unsigned hash)
+{
+    size_t          mask = ix->size - 1 ;
+    size_t          g ;
+    size_t          b ;
+    unsigned char   tag = DICT_CTRL_TAG(hash) ;
+    dict_mask       m ;
+    unsigned        slot ;
+
+    for (g = hash & mask ; ; g = (g + DICT_GROUP_WIDTH) & mask) {
+        for (m = dictionary_group_match(ix->ctrl + g, tag) ; m ; m &= m - 1) {
+            b = (g + dictionary_mask_first(m)) & mask ;
+            slot = ix->slot[b] ;
+            /* Compare hash first, then string to avoid hash collisions */
+            if (ix->ctrl[b] == tag && d->pub.hash[slot] == hash &&
+                dictionary_keyeq(d->flags, key, d->pub.key[slot]))
+                return (ssize_t)b ;
+        }
+        if (dictionary_group_match(ix->ctrl + g, DICT_CTRL_EMPTY))
+            return -1 ;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find the first free bucket on the probe sequence of a hash
+  @param    ix    Index to search
+  @param    hash  Hash value of the key to insert
+  @return   Bucket number, either empty or deleted
+ */
+/*--------------------------------------------------------------------------*/
+static size_t dictionary_index_free(const dict_index * ix, unsigned hash)
+{
+    size_t          mask = ix->size - 1 ;
+    size_t          g ;
+    size_t          b ;
+    dict_mask       m ;
+
+    for (g = hash & mask ; ; g = (g + DICT_GROUP_WIDTH) & mask) {
+        m = dictionary_group_match(ix->ctrl + g, DICT_CTRL_EMPTY) |
+            dictionary_group_match(ix->ctrl + g, DICT_CTRL_DELETED) ;
+        for ( ; m ; m &= m - 1) {
+            b = (g + dictionary_mask_first(m)) & mask ;
+            if (ix->ctrl[b] & DICT_CTRL_EMPTY)
+                return b ;
+        }
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Point a free index bucket to a slot
+  @param    ix    Index to modify
+  @param    slot  Slot number
+  @param    hash  Hash value of the key stored in slot
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_index_insert(dict_index * ix, ssize_t slot, unsigned hash)
+{
+    size_t b = dictionary_index_free(ix, hash) ;
+
+    if (ix->ctrl[b] == DICT_CTRL_EMPTY)
+        ix->used ++ ;
+    ix->slot[b] = (unsigned)slot ;
+    dictionary_set_ctrl(ix, b, DICT_CTRL_TAG(hash));
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find the index bucket pointing to a key in any index
+  @param    d     Dictionary to search
+  @param    key   Key to look for
+  @param    hash  Hash value of key
+  @param    ix    Receives the index holding the bucket
+  @return   Bucket number, or -1 if the key is not in the dictionary
+ */
+/*--------------------------------------------------------------------------*/
+static ssize_t dictionary_locate(
+    const dictionary_impl * d,
+    const char * key,
+    unsigned hash,
+    const dict_index ** ix)
+{
+    ssize_t b ;
+
+    *ix = &d->idx ;
+    b = dictionary_index_find(d, &d->idx, key, hash);
+    if (b<0 && d->old.slot) {
+        *ix = &d->old ;
+        b = dictionary_index_find(d, &d->old, key, hash);
+    }
+    return b ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Move buckets from the old index to the current one
+  @param    d   Dictionary being resized
+  @param    n   Maximum number of old buckets to visit
+  @return   void
+
+  Migrated buckets are marked deleted in the old index, so that probing
+  it keeps working for the buckets left. The old index is released once
+  all its buckets have been visited.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_migrate(dictionary_impl * d, size_t n)
+{
+    unsigned slot ;
+
+    if (d->old.slot==NULL)
+        return ;
+    for ( ; n>0 && d->omig<d->old.size ; n--, d->omig++) {
+        if (d->old.ctrl[d->omig] & DICT_CTRL_EMPTY)
+            continue ;
+        slot = d->old.slot[d->omig] ;
+        dictionary_index_insert(&d->idx, slot, d->pub.hash[slot]);
+        dictionary_set_ctrl(&d->old, d->omig, DICT_CTRL_DELETED);
+    }
+    if (d->omig==d->old.size) {
+        free(d->old.slot);
+        d->old.slot = NULL ;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Point the index bucket of a slot to another slot
+  @param    ix    Index to modify
+  @param    hash  Hash value of the key stored in slot from
+  @param    from  Slot the bucket points to
+  @param    to    Slot the bucket should point to
+  @return   int   1 if the bucket was found in ix, 0 otherwise
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_index_retarget(dict_index * ix, unsigned hash, unsigned from, unsigned to)
+{
+    size_t          mask = ix->size - 1 ;
+    size_t          g ;
+    size_t          b ;
+    unsigned char   tag = DICT_CTRL_TAG(hash) ;
+    dict_mask       m ;
+
+    for (g = hash & mask ; ; g = (g + DICT_GROUP_WIDTH) & mask) {
+        for (m = dictionary_group_match(ix->ctrl + g, tag) ; m ; m &= m - 1) {
+            b = (g + dictionary_mask_first(m)) & mask ;
+            if (ix->ctrl[b] == tag && ix->slot[b] == from) {
+                ix->slot[b] = to ;
+                return 1 ;
+            }
+        }
+        if (dictionary_group_match(ix->ctrl + g, DICT_CTRL_EMPTY))
+            return 0 ;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find the section slot of a key
+  @param    d   Dictionary with a section index
+  @param    i   Slot of a key containing a colon
+  @return   Slot of the section of the key, or -1 if it is not there
+
+  The key copy owned by the dictionary is cut at its first colon while
+  the section is looked up, which saves copying the section name. Keys
+  mostly come in runs of the same section, so the section found last is
+  tried first, without hashing.
+ */
+/*--------------------------------------------------------------------------*/
+static ssize_t dictionary_sect_find(dictionary_impl * d, ssize_t i)
+{
+    const dict_index *  ix ;
+    char            *   colon = strchr(d->pub.key[i], ':') ;
+    size_t              len = (size_t)(colon - d->pub.key[i]) ;
+    ssize_t             b ;
+
+    if (d->slook>=0 && !strncmp(d->pub.key[d->slook], d->pub.key[i], len) &&
+        d->pub.key[d->slook][len]=='\0')
+        return d->slook ;
+    *colon = '\0' ;
+    b = dictionary_locate(d, d->pub.key[i], d->hashfn(d->pub.key[i]), &ix);
+    *colon = ':' ;
+    if (b<0)
+        return -1 ;
+    d->slook = (ssize_t)ix->slot[b] ;
+    return d->slook ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Insert a slot into a chain of the section index
+  @param    d      Dictionary with a section index
+  @param    first  First slot of the chain
+  @param    last   Last slot of the chain
+  @param    i      Slot to insert, kept in slot order
+  @return   void
+
+  New keys always have the highest slot, so the search from the end of
+  the chain stops at once except when orphans are added back.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_sect_chain(dictionary_impl * d, int32_t * first, int32_t * last, ssize_t i)
+{
+    dict_sect   *   s = DICT_SECT(d, i) ;
+    int32_t         p = *last ;
+
+    while (p>=0 && p>i)
+        p = DICT_SECT(d, p)->prev ;
+    s->prev = p ;
+    s->next = p>=0 ? DICT_SECT(d, p)->next : *first ;
+    if (s->next>=0)
+        DICT_SECT(d, s->next)->prev = (int32_t)i ;
+    else
+        *last = (int32_t)i ;
+    if (p>=0)
+        DICT_SECT(d, p)->next = (int32_t)i ;
+    else
+        *first = (int32_t)i ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Remove a slot from a chain of the section index
+  @param    d      Dictionary with a section index
+  @param    first  First slot of the chain
+  @param    last   Last slot of the chain
+  @param    i      Slot to remove
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_sect_unchain(dictionary_impl * d, int32_t * first, int32_t * last, ssize_t i)
+{
+    dict_sect   *   s = DICT_SECT(d, i) ;
+
+    if (s->prev>=0)
+        DICT_SECT(d, s->prev)->next = s->next ;
+    else
+        *first = s->next ;
+    if (s->next>=0)
+        DICT_SECT(d, s->next)->prev = s->prev ;
+    else
+        *last = s->prev ;
+    s->prev = s->next = -1 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Release the section index of a dictionary
+  @param    d   Dictionary with a section index
+  @return   void
+
+  Section queries then report that there is no index.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_sect_drop(dictionary_impl * d)
+{
+    size_t s ;
+
+    for (s=0 ; d->sect && s<d->nseg ; s++)
+        free(d->sect[s]);
+    free(d->sect);
+    free(d->orph);
+    d->sect    = NULL ;
+    d->orph    = NULL ;
+    d->osize   = d->oused = d->ogroups = 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Hash the section name of a key
+  @param    d   Dictionary with a section index
+  @param    i   Slot of a key containing a colon
+  @return   Hash of the part of the key before its first colon
+ */
+/*--------------------------------------------------------------------------*/
+static unsigned dictionary_orphans_hash(dictionary_impl * d, ssize_t i)
+{
+    char        *   colon = strchr(d->pub.key[i], ':') ;
+    unsigned        h ;
+
+    *colon = '\0' ;
+    h = d->hashfn(d->pub.key[i]) ;
+    *colon = ':' ;
+    return h ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find the orphan chain of a section name
+  @param    d     Dictionary with a section index
+  @param    name  Section name, not necessarily NUL-terminated
+  @param    len   Length of the name
+  @param    hash  Hash of the name
+  @return   Bucket of the chain, or -1 if the name has no orphans
+ */
+/*--------------------------------------------------------------------------*/
+static ssize_t dictionary_orphans_find(
+    const dictionary_impl * d,
+    const char * name,
+    size_t len,
+    unsigned hash)
+{
+    const dict_orphans  *   o ;
+    const char          *   k ;
+    size_t                  mask, b ;
+
+    if (d->orph==NULL)
+        return -1 ;
+    mask = d->osize - 1 ;
+    for (b=hash & mask ; d->orph[b].first!=DICT_ORPHANS_FREE ; b=(b + 1) & mask) {
+        o = d->orph + b ;
+        if (o->first<0 || o->hash!=hash)
+            continue ;
+        k = d->pub.key[o->first] ;
+        if (!strncmp(k, name, len) && k[len]==':')
+            return (ssize_t)b ;
+    }
+    return -1 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Make room for new orphan chains
+  @param    d   Dictionary with a section index
+  @param    n   Number of chains about to be added
+  @return   This function returns non-zero in case of failure
+
+  The table is kept at most half full, deleted buckets included, and
+  rebuilt at twice that room when it needs to grow.
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_orphans_reserve(dictionary_impl * d, size_t n)
+{
+    dict_orphans    *   t ;
+    size_t              size, i, b ;
+
+    if ((d->oused + n) * 2 <= d->osize)
+        return 0 ;
+    for (size=DICT_ORPHANS_MIN ; size < (d->ogroups + n) * 4 ; size *= 2) ;
+    t = (dict_orphans*) malloc(size * sizeof *t);
+    if (t==NULL)
+        return -1 ;
+    for (i=0 ; i<size ; i++)
+        t[i].first = DICT_ORPHANS_FREE ;
+    for (i=0 ; i<d->osize ; i++) {
+        if (d->orph[i].first<0)
+            continue ;
+        for (b=d->orph[i].hash & (size - 1) ; t[b].first!=DICT_ORPHANS_FREE ;
+             b=(b + 1) & (size - 1)) ;
+        t[b] = d->orph[i] ;
+    }
+    free(d->orph);
+    d->orph  = t ;
+    d->osize = size ;
+    d->oused = d->ogroups ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Add a key to its section, or to the orphans
+  @param    d   Dictionary with a section index
+  @param    i   Slot of a key containing a colon
+  @param    sec Slot of the section of the key, or -1
+  @return   void
+
+  Orphans need room for a new chain, see dictionary_orphans_reserve().
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_sect_adopt(dictionary_impl * d, ssize_t i, ssize_t sec)
+{
+    const char  *   k = d->pub.key[i] ;
+    unsigned        h ;
+    size_t          mask ;
+    ssize_t         b ;
+
+    if (sec>=0) {
+        dictionary_sect_chain(d, &DICT_SECT(d, sec)->first, &DICT_SECT(d, sec)->last, i);
+        DICT_SECT(d, sec)->count ++ ;
+        return ;
+    }
+    h = dictionary_orphans_hash(d, i) ;
+    b = dictionary_orphans_find(d, k, (size_t)(strchr(k, ':') - k), h);
+    if (b<0) {
+        mask = d->osize - 1 ;
+        for (b=(ssize_t)(h & mask) ; d->orph[b].first>=0 ; b=(ssize_t)((b + 1) & mask)) ;
+        if (d->orph[b].first==DICT_ORPHANS_FREE)
+            d->oused ++ ;
+        d->ogroups ++ ;
+        d->orph[b].hash  = h ;
+        d->orph[b].first = d->orph[b].last = -1 ;
+    }
+    dictionary_sect_chain(d, &d->orph[b].first, &d->orph[b].last, i);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Link a new entry into the section index
+  @param    d   Dictionary with a section index
+  @param    i   Slot of the entry
+  @return   void
+
+  A new section takes over the orphans of its name.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_sect_link(dictionary_impl * d, ssize_t i)
+{
+    dict_sect   *   s = DICT_SECT(d, i) ;
+    int32_t         first, last ;
+    int32_t         o, next ;
+    ssize_t         sec, b ;
+
+    s->first = s->last = -1 ;
+    s->count = 0 ;
+    if (strchr(d->pub.key[i], ':')) {
+        sec = dictionary_sect_find(d, i) ;
+        if (sec<0 && dictionary_orphans_reserve(d, 1)!=0) {
+            dictionary_sect_drop(d);
+            return ;
+        }
+        dictionary_sect_adopt(d, i, sec);
+        return ;
+    }
+    first = (int32_t)d->sfirst ;
+    last  = (int32_t)d->slast ;
+    dictionary_sect_chain(d, &first, &last, i);
+    d->sfirst = first ;
+    d->slast  = last ;
+    d->nsec ++ ;
+    b = dictionary_orphans_find(d, d->pub.key[i], strlen(d->pub.key[i]),
+                                d->pub.hash[i]);
+    if (b<0)
+        return ;
+    for (o=d->orph[b].first ; o>=0 ; o=next) {
+        next = DICT_SECT(d, o)->next ;
+        DICT_SECT(d, o)->prev = DICT_SECT(d, o)->next = -1 ;
+        dictionary_sect_adopt(d, o, i);
+    }
+    d->orph[b].first = DICT_ORPHANS_DELETED ;
+    d->ogroups -- ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Unlink an entry about to be deleted from the section index
+  @param    d   Dictionary with a section index
+  @param    i   Slot of the entry
+  @return   void
+
+  The keys of a deleted section become orphans.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_sect_unlink(dictionary_impl * d, ssize_t i)
+{
+    dict_sect   *   s = DICT_SECT(d, i) ;
+    const char  *   k = d->pub.key[i] ;
+    int32_t         first, last ;
+    int32_t         j, next ;
+    ssize_t         sec, b ;
+
+    if (strchr(k, ':')) {
+        sec = dictionary_sect_find(d, i) ;
+        if (sec>=0) {
+            dictionary_sect_unchain(d, &DICT_SECT(d, sec)->first, &DICT_SECT(d, sec)->last, i);
+            DICT_SECT(d, sec)->count -- ;
+            return ;
+        }
+        b = dictionary_orphans_find(d, k, (size_t)(strchr(k, ':') - k),
+                                    dictionary_orphans_hash(d, i));
+        dictionary_sect_unchain(d, &d->orph[b].first, &d->orph[b].last, i);
+        if (d->orph[b].first<0) {
+            d->orph[b].first = DICT_ORPHANS_DELETED ;
+            d->ogroups -- ;
+        }
+        return ;
+    }
+    if (s->first>=0 && dictionary_orphans_reserve(d, 1)!=0) {
+        dictionary_sect_drop(d);
+        return ;
+    }
+    first = (int32_t)d->sfirst ;
+    last  = (int32_t)d->slast ;
+    dictionary_sect_unchain(d, &first, &last, i);
+    d->sfirst = first ;
+    d->slast  = last ;
+    d->nsec -- ;
+    if (d->slook==i)
+        d->slook = -1 ;
+    for (j=s->first ; j>=0 ; j=next) {
+        next = DICT_SECT(d, j)->next ;
+        DICT_SECT(d, j)->prev = DICT_SECT(d, j)->next = -1 ;
+        dictionary_sect_adopt(d, j, -1);
+    }
+    s->first = s->last = -1 ;
+    s->count = 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Move an entry down to a deleted slot
+  @param    d   Dictionary being packed
+  @param    i   Slot of the entry
+  @param    j   Deleted slot below i, with no entry in between
+  @return   void
+
+  The index bucket, cached conversions and section links of the entry
+  follow it, and no order changes. When the entry ends its section
+  chain, the chain is found before the key moves, as finding orphans
+  reads the first key of their chain.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_move(dictionary_impl * d, ssize_t i, ssize_t j)
+{
+    const char  *   k = d->pub.key[i] ;
+    const char  *   colon ;
+    dict_sect   *   s ;
+    int32_t     *   first = NULL ;
+    int32_t     *   last = NULL ;
+    int32_t         sfirst, slast ;
+    ssize_t         sec, b ;
+
+    if (d->sect && (DICT_SECT(d, i)->prev<0 || DICT_SECT(d, i)->next<0)) {
+        colon = strchr(k, ':') ;
+        if (colon==NULL) {
+            sfirst = (int32_t)d->sfirst ;
+            slast  = (int32_t)d->slast ;
+            first  = &sfirst ;
+            last   = &slast ;
+        } else if ((sec = dictionary_sect_find(d, i)) >= 0) {
+            first = &DICT_SECT(d, sec)->first ;
+            last  = &DICT_SECT(d, sec)->last ;
+        } else {
+            b = dictionary_orphans_find(d, k, (size_t)(colon - k),
+                                        dictionary_orphans_hash(d, i));
+            first = &d->orph[b].first ;
+            last  = &d->orph[b].last ;
+        }
+    }
+    if (!dictionary_index_retarget(&d->idx, d->pub.hash[i], (unsigned)i, (unsigned)j) &&
+        d->old.slot)
+        dictionary_index_retarget(&d->old, d->pub.hash[i], (unsigned)i, (unsigned)j);
+    dictionary_slot_set(d, j, d->pub.key[i], d->pub.val[i], d->pub.hash[i]);
+    dictionary_slot_set(d, i, NULL, NULL, 0);
+    if (d->typed) {
+        *DICT_TYPED(d, j) = *DICT_TYPED(d, i) ;
+        dictionary_typed_reset(d, i);
+    }
+    if (d->slook==i)
+        d->slook = j ;
+    if (d->sect==NULL)
+        return ;
+    s  = DICT_SECT(d, j) ;
+    *s = *DICT_SECT(d, i) ;
+    if (s->prev>=0)
+        DICT_SECT(d, s->prev)->next = (int32_t)j ;
+    else
+        *first = (int32_t)j ;
+    if (s->next>=0)
+        DICT_SECT(d, s->next)->prev = (int32_t)j ;
+    else
+        *last = (int32_t)j ;
+    if (first==&sfirst) {
+        d->sfirst = sfirst ;
+        d->slast  = slast ;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Start moving a dictionary to a fresh index
+  @param    d     Dictionary to reindex
+  @param    size  Number of buckets in the new index, a power of 2
+  @return   This function returns non-zero in case of failure
+
+  A migration still in progress is completed first. The new index only
+  holds the keys inserted from now on, the others are migrated later by
+  dictionary_migrate().
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_index_resize(dictionary_impl * d, size_t size)
+{
+    dict_index  ix ;
+
+    if (dictionary_index_alloc(&ix, size) != 0)
+        return -1 ;
+    if (size > d->idx.size)
+        d->grows ++ ;
+    else if (size < d->idx.size)
+        d->shrinks ++ ;
+    dictionary_migrate(d, (size_t)-1);
+    d->old  = d->idx ;
+    d->idx  = ix ;
+    d->omig = 0 ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Resize the segment tables of a dictionary
+  @param    d     Dictionary to modify
+  @param    size  New number of slots
+  @return   void
+
+  Segments past the new size are freed. A table which cannot grow drops
+  the cache or section index, one which cannot shrink stays larger.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_seg_resize(dictionary_impl * d, ssize_t size)
+{
+    size_t          nseg = ((size_t)size + DICT_SEG_SIZE - 1) >> DICT_SEG_SHIFT ;
+    dict_typed  **  new_typed ;
+    dict_sect   **  new_sect ;
+    size_t          s ;
+
+    for (s=nseg ; s<d->nseg ; s++) {
+        if (d->typed) {
+            free(d->typed[s]);
+            d->typed[s] = NULL ;
+        }
+        if (d->sect) {
+            free(d->sect[s]);
+            d->sect[s] = NULL ;
+        }
+    }
+    if (d->typed) {
+        new_typed = (dict_typed**) realloc(d->typed, nseg * sizeof *new_typed);
+        if (new_typed) {
+            d->typed = new_typed ;
+            for (s=d->nseg ; s<nseg ; s++)
+                d->typed[s] = NULL ;
+        } else if (nseg > d->nseg) {
+            dictionary_typed_drop(d);
+        }
+    }
+    if (d->sect) {
+        new_sect = (dict_sect**) realloc(d->sect, nseg * sizeof *new_sect);
+        if (new_sect) {
+            d->sect = new_sect ;
+            for (s=d->nseg ; s<nseg ; s++)
+                d->sect[s] = NULL ;
+        } else if (nseg > d->nseg) {
+            dictionary_sect_drop(d);
+        }
+    }
+    d->nseg = nseg ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Allocate the segments holding a slot
+  @param    d   Dictionary to modify
+  @param    i   Slot about to be used
+  @return   void
+
+  The cache, or the section index, is dropped if its segment cannot be
+  allocated.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_seg_alloc(dictionary_impl * d, ssize_t i)
+{
+    size_t s = (size_t)i >> DICT_SEG_SHIFT ;
+
+    if (d->typed && d->typed[s]==NULL) {
+        d->typed[s] = (dict_typed*) calloc(DICT_SEG_SIZE, sizeof **d->typed);
+        if (d->typed[s]==NULL)
+            dictionary_typed_drop(d);
+    }
+    if (d->sect && d->sect[s]==NULL) {
+        d->sect[s] = (dict_sect*) malloc(DICT_SEG_SIZE * sizeof **d->sect);
+        if (d->sect[s]==NULL)
+            dictionary_sect_drop(d);
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Give up growing the slot arrays of a dictionary
+  @param    d   Dictionary being grown
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_grow_cancel(dictionary_impl * d)
+{
+    free(d->gval);
+    free(d->gkey);
+    free(d->ghash);
+    d->gval  = NULL ;
+    d->gkey  = NULL ;
+    d->ghash = NULL ;
+    d->gsize = d->gcopy = 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Start growing the slot arrays of a dictionary
+  @param    d     Dictionary to grow
+  @param    size  New number of slots
+  @return   This function returns non-zero in case of failure
+
+  Allocates the larger arrays, which dictionary_grow_step() then fills.
+  On failure the dictionary keeps its arrays.
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_grow_start(dictionary_impl * d, ssize_t size)
+{
+    d->gval  = (char**) calloc(size, sizeof *d->gval);
+    d->gkey  = (char**) calloc(size, sizeof *d->gkey);
+    d->ghash = (unsigned*) calloc(size, sizeof *d->ghash);
+    if (!d->gval || !d->gkey || !d->ghash) {
+        dictionary_grow_cancel(d);
+        return -1 ;
+    }
+    dictionary_seg_resize(d, size);
+    d->gsize = size ;
+    d->gcopy = 0 ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Copy slots to the arrays being grown to
+  @param    d   Dictionary being grown
+  @param    n   Maximum number of slots to copy
+  @return   void
+
+  The larger arrays replace the others once all used slots are copied.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_grow_step(dictionary_impl * d, ssize_t n)
+{
+    if (d->gkey==NULL)
+        return ;
+    for ( ; n>0 && d->gcopy<d->pub.used ; n--, d->gcopy++) {
+        d->gkey[d->gcopy]  = d->pub.key[d->gcopy] ;
+        d->gval[d->gcopy]  = d->pub.val[d->gcopy] ;
+        d->ghash[d->gcopy] = d->pub.hash[d->gcopy] ;
+    }
+    if (d->gcopy<d->pub.used)
+        return ;
+    free(d->pub.val);
+    free(d->pub.key);
+    free(d->pub.hash);
+    d->pub.val  = d->gval ;
+    d->pub.key  = d->gkey ;
+    d->pub.hash = d->ghash ;
+    d->pub.size = d->gsize ;
+    d->gval  = NULL ;
+    d->gkey  = NULL ;
+    d->ghash = NULL ;
+    d->gsize = d->gcopy = 0 ;
+    d->grows ++ ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Grow the slot arrays of a dictionary at once
+  @param    d     Dictionary to grow
+  @param    size  Smallest new number of slots
+  @return   This function returns non-zero in case of failure
+
+  Completes a growth in progress, then grows to size slots if there are
+  still fewer. If the arrays cannot be allocated the dictionary keeps
+  its previous size.
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_grow(dictionary * d, ssize_t size)
+{
+    dictionary_impl * di = DICT_IMPL(d) ;
+
+    dictionary_grow_step(di, d->used);
+    if (size <= d->size)
+        return 0 ;
+    if (dictionary_grow_start(di, size) != 0)
+        return -1 ;
+    dictionary_grow_step(di, d->used);
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Shrink the slot arrays of a dictionary
+  @param    d     Dictionary to shrink, with entries below size
+  @param    size  New number of slots
+  @return   void
+
+  A growth in progress is abandoned. An array which cannot be
+  reallocated keeps its larger block, which is harmless, so this cannot
+  fail.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_shrink(dictionary * d, ssize_t size)
+{
+    char        ** new_val ;
+    char        ** new_key ;
+    unsigned     * new_hash ;
+
+    dictionary_grow_cancel(DICT_IMPL(d));
+    new_val = (char**) realloc(d->val, size * sizeof *d->val);
+    if (new_val)
+        d->val = new_val ;
+    new_key = (char**) realloc(d->key, size * sizeof *d->key);
+    if (new_key)
+        d->key = new_key ;
+    new_hash = (unsigned*) realloc(d->hash, size * sizeof *d->hash);
+    if (new_hash)
+        d->hash = new_hash ;
+    dictionary_seg_resize(DICT_IMPL(d), size);
+    d->size = size ;
+    DICT_IMPL(d)->shrinks ++ ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Release memory of a dictionary after many deletions
+  @param    d   Dictionary to check
+  @return   void
+
+  Slot arrays shrink once at most a quarter of them is used, up to the
+  last entry, and the index once it is a sixteenth full, both by half.
+  Growing starts at 3/4 used slots and at 3/8 index load, so a few entries
+  set and unset in turn never resize back and forth. Entries do not
+  move, deleted slots below the last entry are only reused once
+  dictionary_set() packs entries. Failure to shrink the index is
+  ignored.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_trim(dictionary_impl * d)
+{
+    ssize_t size = d->pub.size / 2 ;
+
+    if (size >= DICTMINSZ && d->pub.used * DICT_SHRINK_RATIO <= d->pub.size)
+        dictionary_shrink(&d->pub, size);
+    if (d->idx.size > DICTMINSZ &&
+        (size_t)d->pub.n * DICT_ISHRINK_RATIO <= d->idx.size)
+        dictionary_index_resize(d, d->idx.size / 2);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Move entries down over deleted slots
+  @param    d   Dictionary being packed
+  @param    n   Maximum number of slots to look at
+  @return   void
+
+  Live entries keep their order and move down to pdst as psrc walks up
+  the slots. Once psrc reaches the last used slot, the slots above pdst
+  are released and the storage may shrink. This cannot fail.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_pack(dictionary_impl * d, ssize_t n)
+{
+    if (d->pdst<0)
+        return ;
+    for ( ; n>0 && d->psrc<d->pub.used ; n--, d->psrc++) {
+        if (d->pub.key[d->psrc]==NULL)
+            continue ;
+        if (d->psrc!=d->pdst)
+            dictionary_move(d, d->psrc, d->pdst);
+        d->pdst ++ ;
+    }
+    if (d->psrc<d->pub.used)
+        return ;
+    if (d->pub.used > d->pdst)
+        d->pub.used = d->pdst ;
+    d->pdst = -1 ;
+    dictionary_trim(d);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compute the wide hash of a string, optionally ignoring case
+  @param    key     Character string to hash
+  @param    fold    Non-zero to hash ASCII letters in lower case
+  @return   1 unsigned int on at least 32 bits.
+
+  Reads the key 16 bytes at a time and mixes them with 64x64->128 bit
+  multiplications, in the manner of wyhash. Case is folded on the 8-byte
+  words as they are read, so folding costs no copy of the key.
+ */
+/*--------------------------------------------------------------------------*/
+static unsigned dictionary_hash_wide(const char * key, int fold)
+{
+    size_t          len ;
+    const char  *   p = key ;
+    uint64_t        a, b, h ;
+
+    if (!key)
+        return 0 ;
+
+    len = strlen(key);
+    h = DICT_HASH_P0 ^ dictionary_mum(len ^ DICT_HASH_P1, DICT_HASH_P0) ;
+    for ( ; len>16 ; p+=16, len-=16) {
+        memcpy(&a, p, 8);
+        memcpy(&b, p + 8, 8);
+        if (fold) {
+            a = dictionary_fold64(a);
+            b = dictionary_fold64(b);
+        }
+        h = dictionary_mum(a ^ DICT_HASH_P1, b ^ h) ;
+    }
+    /* Last 1 to 16 bytes, zero padded */
+    a = b = 0 ;
+    if (len>8) {
+        memcpy(&a, p, 8);
+        memcpy(&b, p + 8, len - 8);
+    } else {
+        memcpy(&a, p, len);
+    }
+    if (fold) {
+        a = dictionary_fold64(a);
+        b = dictionary_fold64(b);
+    }
+    h = dictionary_mum(a ^ DICT_HASH_P1, b ^ h ^ DICT_HASH_P2) ;
+    h = dictionary_mum(h ^ DICT_HASH_P3, h ^ DICT_HASH_P1) ;
+    return (unsigned)(h ^ (h >> 32)) ;
+}
+
+/*---------------------------------------------------------------------------
+                            Function codes
+ ---------------------------------------------------------------------------*/
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compute the hash key for a string.
+  @param    key     Character string to use for key.
+  @return   1 unsigned int on at least 32 bits.
+
+  This is the default hash function of dictionaries. It reads the key
+  16 bytes at a time and mixes them with 64x64->128 bit multiplications,
+  in the manner of wyhash, which is much faster than hashing one byte at
+  a time on the long section-prefixed keys of ini files. The value of a
+  key may differ between platforms of different endianness.
+  The key is stored anyway in the struct so that collision can be avoided
+  by comparing the key itself in last resort.
+ */
+/*--------------------------------------------------------------------------*/
+unsigned dictionary_hash(const char * key)
+{
+    return dictionary_hash_wide(key, 0);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compute the case-insensitive hash key for a string.
+  @param    key     Character string to use for key.
+  @return   1 unsigned int on at least 32 bits.
+
+  Same as dictionary_hash() on the key converted to lower case, with
+  ASCII letters folded 8 bytes at a time while hashing.
+ */
+/*--------------------------------------------------------------------------*/
+unsigned dictionary_hash_nocase(const char * key)
+{
+    return dictionary_hash_wide(key, 1);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compute the one-at-a-time hash key for a string.
+  @param    key     Character string to use for key.
+  @return   1 unsigned int on at least 32 bits.
+
+  This hash function has been taken from an Article in Dr Dobbs Journal.
+  This is normally a collision-free function, distributing keys evenly.
+  It was the hash function of dictionaries before dictionary_hash(), and
+  can still be selected with dictionary_new_hash().
+ */
+/*--------------------------------------------------------------------------*/
+unsigned dictionary_hash_oat(const char * key)
+{
+    size_t      len ;
+    unsigned    hash ;
+    size_t      i ;
+
+    if (!key)
+        return 0 ;
+
+    len = strlen(key);
+    for (hash=0, i=0 ; i<len ; i++) {
+        hash += (unsigned)key[i] ;
+        hash += (hash<<10);
+        hash ^= (hash>>6) ;
+    }
+    hash += (hash <<3);
+    hash ^= (hash >>11);
+    hash += (hash <<15);
+    return hash ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Create a new dictionary object.
+  @param    size    Optional initial size of the dictionary.
+  @return   1 newly allocated dictionary objet.
+
+  This function allocates a new dictionary object of given size and returns
+  it. If you do not know in advance (roughly) the number of entries in the
+  dictionary, give size=0.
+ */
+/*-------------------------------------------------------------------------*/
+dictionary * dictionary_new(size_t size)
+{
+    return dictionary_new_flags(size, 0);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Create a new dictionary object with creation flags.
+  @param    size    Optional initial size of the dictionary.
+  @param    flags   Bitwise or of DICTIONARY_* flags.
+  @return   1 newly allocated dictionary objet.
+
+  Same as dictionary_new(), with the storage behaviour selected by flags.
+ */
+/*-------------------------------------------------------------------------*/
+dictionary * dictionary_new_flags(size_t size, unsigned flags)
+{
+    return dictionary_new_hash(size, flags, NULL);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Create a new dictionary object with its own hash function.
+  @param    size    Optional initial size of the dictionary.
+  @param    flags   Bitwise or of DICTIONARY_* flags.
+  @param    hash    Hash function of keys, NULL for dictionary_hash().
+  @return   1 newly allocated dictionary objet.
+
+  Same as dictionary_new_flags(), hashing keys with the given function.
+ */
+/*-------------------------------------------------------------------------*/
+dictionary * dictionary_new_hash(size_t size, unsigned flags, dictionary_hash_fn hash)
+{
+    dictionary_impl *   d ;
+
+    /* If no size was specified, allocate space for DICTMINSZ */
+    if (size<DICTMINSZ) size=DICTMINSZ ;
+
+    d = (dictionary_impl*) calloc(1, sizeof *d) ;
+
+    if (d) {
+        d->flags    = flags ;
+        d->hashfn   = hash ? hash :
+                      (flags & DICTIONARY_NOCASE) ? dictionary_hash_nocase :
+                                                    dictionary_hash ;
+        d->pub.size = size ;
+        d->sfirst   = d->slast = -1 ;
+        d->slook    = -1 ;
+        d->pdst     = -1 ;
+        /* The conversion cache is optional, and so is the section index */
+        d->nseg  = (size + DICT_SEG_SIZE - 1) >> DICT_SEG_SHIFT ;
+        d->typed = (dict_typed**) calloc(d->nseg, sizeof *d->typed);
+        if (flags & DICTIONARY_SECTIONS)
+            d->sect = (dict_sect**) calloc(d->nseg, sizeof *d->sect);
+        d->pub.val  = (char**) calloc(size, sizeof *d->pub.val);
+        d->pub.key  = (char**) calloc(size, sizeof *d->pub.key);
+        d->pub.hash = (unsigned*) calloc(size, sizeof *d->pub.hash);
+        if (!d->pub.val || !d->pub.key || !d->pub.hash ||
+            dictionary_index_alloc(&d->idx, dictionary_index_size(size)) != 0) {
+            dictionary_del(&d->pub);
+            return NULL ;
+        }
+    }
+    return d ? &d->pub : NULL ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the creation flags of a dictionary.
+  @param    d       dictionary object to examine.
+  @return   Bitwise or of the DICTIONARY_* flags d was created with.
+ */
+/*--------------------------------------------------------------------------*/
+unsigned dictionary_flags(const dictionary * d)
+{
+    return d ? ((const dictionary_impl *)d)->flags : 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the hash function of a dictionary.
+  @param    d       dictionary object to examine.
+  @return   Function used to hash the keys of d.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary_hash_fn dictionary_hashfn(const dictionary * d)
+{
+    return d ? ((const dictionary_impl *)d)->hashfn : dictionary_hash ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Lend storage to a dictionary.
+  @param    d       dictionary object to modify.
+  @param    base    Start of the storage.
+  @param    len     Size of the storage in bytes.
+  @param    release Function handing the storage back, or NULL.
+  @return   int     0 if Ok, anything else otherwise
+
+  From then on, values given to dictionary_set() which lie within the
+  storage are stored as is instead of being copied. They must stay valid
+  and unchanged until dictionary_del(), which calls release(base, len)
+  if it is not NULL. A dictionary can only borrow one storage.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_borrow(dictionary * d, void * base, size_t len, dictionary_release_fn release)
+{
+    dictionary_impl *   di = DICT_IMPL(d) ;
+
+    if (d==NULL || base==NULL || di->bbase!=NULL) return -1 ;
+    di->bbase    = (char*)base ;
+    di->blen     = len ;
+    di->brelease = release ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Make room for a number of entries in a dictionary.
+  @param    d       dictionary object to modify.
+  @param    n       Number of entries the dictionary should hold.
+  @return   int     0 if Ok, anything else otherwise
+
+  Grows the dictionary storage and index at once so that the next
+  insertions, up to n entries in total, do not trigger any resizing.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_reserve(dictionary * d, size_t n)
+{
+    dictionary_impl *   di = DICT_IMPL(d) ;
+    size_t              isize ;
+
+    if (d==NULL) return -1 ;
+
+    if ((ssize_t)n > d->size && dictionary_grow(d, (ssize_t)n) != 0)
+        return -1 ;
+    isize = dictionary_index_size(n);
+    if (isize > di->idx.size) {
+        if (dictionary_index_resize(di, isize) != 0)
+            return -1 ;
+        dictionary_migrate(di, (size_t)-1);
+    }
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Release all unused memory of a dictionary.
+  @param    d       dictionary object to compact.
+  @return   int     0 if Ok, anything else otherwise
+
+  Moves entries to the first d->n slots, shrinks the storage to fit them,
+  rebuilds the index at its smallest size and, in arena mode, copies the
+  strings to a single chunk, dropping the released ones kept for reuse.
+  Slots and index then grow again as needed. On failure the dictionary
+  stays usable, only less compact.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_compact(dictionary * d)
+{
+    dictionary_impl *   di = DICT_IMPL(d) ;
+    ssize_t             size ;
+
+    if (d==NULL) return -1 ;
+
+    if (di->pdst<0)
+        di->pdst = di->psrc = 0 ;
+    dictionary_pack(di, d->used);
+    size = d->n < DICTMINSZ ? DICTMINSZ : d->n ;
+    if (size < d->size)
+        dictionary_shrink(d, size);
+    if (dictionary_index_resize(di, dictionary_index_size((size_t)d->n)) != 0)
+        return -1 ;
+    dictionary_migrate(di, (size_t)-1);
+    if ((di->flags & DICTIONARY_ARENA) && di->adead > 0 &&
+        dictionary_arena_compact(di) != 0)
+        return -1 ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete a dictionary object
+  @param    d   dictionary object to deallocate.
+  @return   void
+
+  Deallocate a dictionary object and all memory associated to it.
+ */
+/*--------------------------------------------------------------------------*/
+void dictionary_del(dictionary * d)
+{
+    ssize_t  i ;
+
+    if (d==NULL) return ;
+    if (DICT_IMPL(d)->flags & DICTIONARY_ARENA) {
+        dictionary_arena_free_big(DICT_IMPL(d));
+        dictionary_arena_free(DICT_IMPL(d)->chunks);
+    } else {
+        for (i=0 ; i<d->used && d->key && d->val ; i++) {
+            if (d->key[i]!=NULL)
+                free(d->key[i]);
+            if (d->val[i]!=NULL && !dictionary_borrowed(DICT_IMPL(d), d->val[i]))
+                free(d->val[i]);
+        }
+    }
+    if (DICT_IMPL(d)->brelease)
+        DICT_IMPL(d)->brelease(DICT_IMPL(d)->bbase, DICT_IMPL(d)->blen);
+    free(d->val);
+    free(d->key);
+    free(d->hash);
+    dictionary_grow_cancel(DICT_IMPL(d));
+    dictionary_typed_drop(DICT_IMPL(d));
+    dictionary_sect_drop(DICT_IMPL(d));
+    free(DICT_IMPL(d)->idx.slot);
+    free(DICT_IMPL(d)->old.slot);
+    free(d);
+    return ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a dictionary.
+  @param    d       dictionary object to search.
+  @param    key     Key to look for in the dictionary.
+  @param    def     Default value to return if key not found.
+  @return   1 pointer to internally allocated character string.
+
+  This function locates a key in a dictionary and returns a pointer to its
+  value, or the passed 'def' pointer if no such key can be found in
+  dictionary. The returned character pointer points to data internal to the
+  dictionary object, you should not try to free it or modify it.
+ */
+/*--------------------------------------------------------------------------*/
+const char * dictionary_get(const dictionary * d, const char * key, const char * def)
+{
+    return dictionary_get_hashed(d, key, ((const dictionary_impl *)d)->hashfn(key), def);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a dictionary, given the hash of its key.
+  @param    d       dictionary object to search.
+  @param    key     Key to look for in the dictionary.
+  @param    hash    Hash of key, as returned by dictionary_hashfn(d)(key).
+  @param    def     Default value to return if key not found.
+  @return   1 pointer to internally allocated character string.
+ */
+/*--------------------------------------------------------------------------*/
+const char * dictionary_get_hashed(
+    const dictionary * d,
+    const char * key,
+    unsigned hash,
+    const char * def)
+{
+    const dictionary_impl * di = (const dictionary_impl *)d ;
+    const dict_index *  ix ;
+    ssize_t     b ;
+
+    DICT_COUNT(di, gets);
+    b = dictionary_locate(di, key, hash, &ix);
+    if (b<0) {
+        DICT_COUNT(di, misses);
+        return def ;
+    }
+    return d->val[ix->slot[b]] ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find the value of a key and its conversion cache
+  @param    d     Dictionary to search
+  @param    key   Key to look for
+  @param    hash  Hash value of key
+  @param    val   Receives the value, or DICT_INVALID_KEY if not found
+  @return   Cache entry of the key, or NULL if there is none
+
+  Without a cache, dropped when memory ran short, callers convert the
+  value every time.
+ */
+/*--------------------------------------------------------------------------*/
+static dict_typed * dictionary_typed(
+    const dictionary * d,
+    const char * key,
+    unsigned hash,
+    const char ** val)
+{
+    const dictionary_impl * di = (const dictionary_impl *)d ;
+    const dict_index *  ix ;
+    ssize_t             b ;
+    unsigned            i ;
+
+    *val = DICT_INVALID_KEY ;
+    if (d==NULL || key==NULL)
+        return NULL ;
+    DICT_COUNT(di, gets);
+    b = dictionary_locate(di, key, hash, &ix);
+    if (b<0) {
+        DICT_COUNT(di, misses);
+        return NULL ;
+    }
+    i = ix->slot[b] ;
+    *val = d->val[i] ;
+    if (*val==NULL)
+        return NULL ;
+    return di->typed ? DICT_TYPED(di, i) : NULL ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Convert a string to a boolean
+  @param    c   String to convert
+  @return   1 for true, 0 for false, -1 if the string is not a boolean
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_str2bool(const char * c)
+{
+    if (c[0]=='y' || c[0]=='Y' || c[0]=='1' || c[0]=='t' || c[0]=='T')
+        return 1 ;
+    if (c[0]=='n' || c[0]=='N' || c[0]=='0' || c[0]=='f' || c[0]=='F')
+        return 0 ;
+    return -1 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a dictionary, converted to a long int.
+  @param    d         dictionary object to search.
+  @param    key       Key to look for in the dictionary.
+  @param    notfound  Value to return if key not found.
+  @return   long integer
+
+  The conversion is done by strtol() with base 0 on the first lookup
+  of a value, and cached until the value changes.
+ */
+/*--------------------------------------------------------------------------*/
+long int dictionary_getlongint(const dictionary * d, const char * key, long int notfound)
+{
+    if (d==NULL || key==NULL)
+        return notfound ;
+    return dictionary_getlongint_hashed(d, key, DICT_IMPL(d)->hashfn(key), notfound);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Same as dictionary_getlongint(), given the hash of the key.
+  @param    d         dictionary object to search.
+  @param    key       Key to look for in the dictionary.
+  @param    hash      Hash value of key.
+  @param    notfound  Value to return if key not found.
+ */
+/*--------------------------------------------------------------------------*/
+long int dictionary_getlongint_hashed(
+    const dictionary * d,
+    const char * key,
+    unsigned hash,
+    long int notfound)
+{
+    dict_typed  *   t ;
+    const char  *   str ;
+    long int        l ;
+
+    t = dictionary_typed(d, key, hash, &str);
+    if (str==DICT_INVALID_KEY || str==NULL)
+        return notfound ;
+    if (t==NULL)
+        return strtol(str, NULL, 0);
+    if (atomic_load_explicit(&t->flags, memory_order_acquire) & DICT_TYPED_LONG)
+        return atomic_load_explicit(&t->l, memory_order_relaxed);
+    l = strtol(str, NULL, 0);
+    atomic_store_explicit(&t->l, l, memory_order_relaxed);
+    atomic_fetch_or_explicit(&t->flags, DICT_TYPED_LONG, memory_order_release);
+    return l ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a dictionary, converted to a double.
+  @param    d         dictionary object to search.
+  @param    key       Key to look for in the dictionary.
+  @param    notfound  Value to return if key not found.
+  @return   double
 
-  This function allocates a new dictionary object of given size and returns
-  it. If you do not know in advance (roughly) the number of entries in the
-  dictionary, give size=0.
+  The conversion is done by atof() on the first lookup of a value, and
+  cached until the value changes.
  */
-/*-------------------------------------------------------------------------*/
-dictionary * dictionary_new(size_t size)
+/*--------------------------------------------------------------------------*/
+double dictionary_getdouble(const dictionary * d, const char * key, double notfound)
 {
-    dictionary  *   d ;
-
-    /* If no size was specified, allocate space for DICTMINSZ */
-    if (size<DICTMINSZ) size=DICTMINSZ ;
+    if (d==NULL || key==NULL)
+        return notfound ;
+    return dictionary_getdouble_hashed(d, key, DICT_IMPL(d)->hashfn(key), notfound);
+}
 
-    d = (dictionary*) calloc(1, sizeof *d) ;
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Same as dictionary_getdouble(), given the hash of the key.
+  @param    d         dictionary object to search.
+  @param    key       Key to look for in the dictionary.
+  @param    hash      Hash value of key.
+  @param    notfound  Value to return if key not found.
+ */
+/*--------------------------------------------------------------------------*/
+double dictionary_getdouble_hashed(
+    const dictionary * d,
+    const char * key,
+    unsigned hash,
+    double notfound)
+{
+    dict_typed  *   t ;
+    const char  *   str ;
+    double          f ;
 
-    if (d) {
-        d->size = size ;
-        d->val  = (char**) calloc(size, sizeof *d->val);
-        d->key  = (char**) calloc(size, sizeof *d->key);
-        d->hash = (unsigned*) calloc(size, sizeof *d->hash);
-    }
-    return d ;
+    t = dictionary_typed(d, key, hash, &str);
+    if (str==DICT_INVALID_KEY || str==NULL)
+        return notfound ;
+    if (t==NULL)
+        return atof(str);
+    if (atomic_load_explicit(&t->flags, memory_order_acquire) & DICT_TYPED_DOUBLE)
+        return atomic_load_explicit(&t->f, memory_order_relaxed);
+    f = atof(str);
+    atomic_store_explicit(&t->f, f, memory_order_relaxed);
+    atomic_fetch_or_explicit(&t->flags, DICT_TYPED_DOUBLE, memory_order_release);
+    return f ;
 }
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief    Delete a dictionary object
-  @param    d   dictionary object to deallocate.
-  @return   void
+  @brief    Get a value from a dictionary, converted to a boolean.
+  @param    d         dictionary object to search.
+  @param    key       Key to look for in the dictionary.
+  @param    notfound  Value to return if key not found or not a boolean.
+  @return   integer
 
-  Deallocate a dictionary object and all memory associated to it.
+  The value is read as true if it starts with one of "yYtT1" and false
+  if it starts with one of "nNfF0". The result is cached until the
+  value changes.
  */
 /*--------------------------------------------------------------------------*/
-void dictionary_del(dictionary * d)
+int dictionary_getboolean(const dictionary * d, const char * key, int notfound)
 {
-    ssize_t  i ;
-
-    if (d==NULL) return ;
-    for (i=0 ; i<d->size ; i++) {
-        if (d->key[i]!=NULL)
-            free(d->key[i]);
-        if (d->val[i]!=NULL)
-            free(d->val[i]);
-    }
-    free(d->val);
-    free(d->key);
-    free(d->hash);
-    free(d);
-    return ;
+    if (d==NULL || key==NULL)
+        return notfound ;
+    return dictionary_getboolean_hashed(d, key, DICT_IMPL(d)->hashfn(key), notfound);
 }
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief    Get a value from a dictionary.
-  @param    d       dictionary object to search.
-  @param    key     Key to look for in the dictionary.
-  @param    def     Default value to return if key not found.
-  @return   1 pointer to internally allocated character string.
-
-  This function locates a key in a dictionary and returns a pointer to its
-  value, or the passed 'def' pointer if no such key can be found in
-  dictionary. The returned character pointer points to data internal to the
-  dictionary object, you should not try to free it or modify it.
+  @brief    Same as dictionary_getboolean(), given the hash of the key.
+  @param    d         dictionary object to search.
+  @param    key       Key to look for in the dictionary.
+  @param    hash      Hash value of key.
+  @param    notfound  Value to return if key not found.
  */
 /*--------------------------------------------------------------------------*/
-const char * dictionary_get(const dictionary * d, const char * key, const char * def)
+int dictionary_getboolean_hashed(
+    const dictionary * d,
+    const char * key,
+    unsigned hash,
+    int notfound)
 {
-    unsigned    hash ;
-    ssize_t      i ;
+    dict_typed  *   t ;
+    const char  *   str ;
+    int             b ;
 
-    hash = dictionary_hash(key);
-    for (i=0 ; i<d->size ; i++) {
-        if (d->key[i]==NULL)
-            continue ;
-        /* Compare hash */
-        if (hash==d->hash[i]) {
-            /* Compare string, to avoid hash collisions */
-            if (!strcmp(key, d->key[i])) {
-                return d->val[i] ;
-            }
-        }
+    t = dictionary_typed(d, key, hash, &str);
+    if (str==DICT_INVALID_KEY || str==NULL)
+        return notfound ;
+    if (t==NULL) {
+        b = dictionary_str2bool(str);
+    } else if (atomic_load_explicit(&t->flags, memory_order_acquire) & DICT_TYPED_BOOL) {
+        b = atomic_load_explicit(&t->b, memory_order_relaxed);
+    } else {
+        b = dictionary_str2bool(str);
+        atomic_store_explicit(&t->b, (signed char)b, memory_order_relaxed);
+        atomic_fetch_or_explicit(&t->flags, DICT_TYPED_BOOL, memory_order_release);
     }
-    return def ;
+    return b<0 ? notfound : b ;
 }
 
 /*-------------------------------------------------------------------------*/
@@ -254,49 +2464,100 @@ const char * dictionary_get(const dictionary * d, const char * key, const char *
 /*--------------------------------------------------------------------------*/
 int dictionary_set(dictionary * d, const char * key, const char * val)
 {
+    if (d==NULL || key==NULL) return -1 ;
+    /* Compute hash for this key */
+    return dictionary_set_hashed(d, key, DICT_IMPL(d)->hashfn(key), val);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set a value in a dictionary, given the hash of its key.
+  @param    d       dictionary object to modify.
+  @param    key     Key to modify or add.
+  @param    hash    Hash of key, as returned by dictionary_hashfn(d)(key).
+  @param    val     Value to add.
+  @return   int     0 if Ok, anything else otherwise
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_set_hashed(dictionary * d, const char * key, unsigned hash, const char * val)
+{
+    dictionary_impl *   di = DICT_IMPL(d) ;
+    const dict_index *  ix ;
     ssize_t         i ;
-    unsigned       hash ;
+    ssize_t         b ;
+    char        *   k ;
+    char        *   v ;
+    char        *   p ;
 
     if (d==NULL || key==NULL) return -1 ;
+    DICT_COUNT(di, sets);
 
-    /* Compute hash for this key */
-    hash = dictionary_hash(key) ;
     /* Find if value is already in dictionary */
-    if (d->n>0) {
-        for (i=0 ; i<d->size ; i++) {
-            if (d->key[i]==NULL)
-                continue ;
-            if (hash==d->hash[i]) { /* Same hash value */
-                if (!strcmp(key, d->key[i])) {   /* Same key */
-                    /* Found a value: modify and return */
-                    if (d->val[i]!=NULL)
-                        free(d->val[i]);
-                    d->val[i] = (val ? xstrdup(val) : NULL);
-                    /* Value has been modified: return */
-                    return 0 ;
-                }
-            }
-        }
+    b = dictionary_locate(di, key, hash, &ix);
+    if (b>=0) {
+        /* Found a value: modify and return */
+        i = ix->slot[b] ;
+        v = dictionary_borrowed(di, val) ? (char*)val : dictionary_strdup(di, val);
+        if (val && !v)
+            return -1 ;
+        dictionary_strfree(di, d->val[i]);
+        dictionary_slot_set(di, i, d->key[i], v, hash);
+        dictionary_typed_reset(di, i);
+        dictionary_migrate(di, DICT_MIGRATE_STEP);
+        /* Value has been modified: return */
+        return 0 ;
     }
     /* Add a new value */
-    /* See if dictionary needs to grow */
-    if (d->n==d->size) {
-        /* Reached maximum size: reallocate dictionary */
-        if (dictionary_grow(d) != 0)
-            return -1;
+    if (d->used - d->n > DICT_HOLES_MIN && d->used - d->n > d->n && di->pdst<0) {
+        /* Mostly deleted slots, left by dictionary_unset(): reuse them */
+        di->pdst = di->psrc = 0 ;
     }
-
-    /* Insert key in the first empty slot. Start at d->n and wrap at
-       d->size. Because d->n < d->size this will necessarily
-       terminate. */
-    for (i=d->n ; d->key[i] ; ) {
-        if(++i == d->size) i = 0;
+    if ((d->size - d->used) * 4 <= d->size) {
+        /* Slots 3/4 used: pack them if many are deleted, unless packing
+           will be done in time, grow them while the last ones get used */
+        if (di->pdst<0 && (d->used - d->n) * 4 >= d->size)
+            di->pdst = di->psrc = 0 ;
+        if (di->gkey==NULL && (di->pdst<0 ||
+            d->used - di->psrc >= (d->size - d->used) * (DICT_SLOT_STEP - 1)))
+            dictionary_grow_start(di, d->size * 2);
     }
+    dictionary_pack(di, DICT_SLOT_STEP);
+    dictionary_grow_step(di, DICT_SLOT_STEP);
+    if (d->used==d->size && dictionary_grow(d, d->size * 2) != 0) {
+        /* Could not grow in time, nor at once */
+        return -1;
+    }
+    if ((di->idx.used + 1) * 4 > di->idx.size * 3) {
+        /* Index too full: double it, or only drop deleted buckets */
+        if (dictionary_index_resize(di, (size_t)(d->n + 1) * 8 > di->idx.size * 3 ?
+                                        di->idx.size * 2 : di->idx.size) != 0)
+            return -1 ;
+    }
+
+    /* Append key after the last used slot, to keep insertion order */
+    i = d->used ;
     /* Copy key */
-    d->key[i]  = xstrdup(key);
-    d->val[i]  = (val ? xstrdup(val) : NULL) ;
-    d->hash[i] = hash;
+    k = dictionary_strdup(di, key);
+    v = dictionary_borrowed(di, val) ? (char*)val : dictionary_strdup(di, val);
+    if (!k || (val && !v)) {
+        dictionary_strfree(di, k);
+        dictionary_strfree(di, v);
+        return -1 ;
+    }
+    if (di->flags & DICTIONARY_NOCASE) {
+        /* Store keys in lower case, lookups fold the keys they compare */
+        for (p=k ; *p ; p++)
+            *p = (char)dictionary_fold((unsigned char)*p);
+    }
+    dictionary_seg_alloc(di, i);
+    dictionary_slot_set(di, i, k, v, hash);
+    dictionary_typed_reset(di, i);
     d->n ++ ;
+    d->used ++ ;
+    dictionary_index_insert(&di->idx, i, hash);
+    if (di->sect)
+        dictionary_sect_link(di, i);
+    dictionary_migrate(di, DICT_MIGRATE_STEP);
     return 0 ;
 }
 
@@ -308,46 +2569,151 @@ int dictionary_set(dictionary * d, const char * key, const char * val)
   @return   void
 
   This function deletes a key in a dictionary. Nothing is done if the
-  key cannot be found.
+  key cannot be found. Other entries stay in their slots.
  */
 /*--------------------------------------------------------------------------*/
 void dictionary_unset(dictionary * d, const char * key)
 {
-    unsigned    hash ;
+    if (key == NULL || d == NULL) {
+        return;
+    }
+    dictionary_unset_hashed(d, key, DICT_IMPL(d)->hashfn(key));
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete a key in a dictionary, given the hash of the key.
+  @param    d       dictionary object to modify.
+  @param    key     Key to remove.
+  @param    hash    Hash of key, as returned by dictionary_hashfn(d)(key).
+  @return   void
+
+  Same as dictionary_unset(), without hashing the key.
+ */
+/*--------------------------------------------------------------------------*/
+void dictionary_unset_hashed(dictionary * d, const char * key, unsigned hash)
+{
+    dictionary_impl *   di = DICT_IMPL(d) ;
+    const dict_index *  ix ;
+    ssize_t      b ;
     ssize_t      i ;
 
     if (key == NULL || d == NULL) {
         return;
     }
 
-    hash = dictionary_hash(key);
-    for (i=0 ; i<d->size ; i++) {
-        if (d->key[i]==NULL)
-            continue ;
-        /* Compare hash */
-        if (hash==d->hash[i]) {
-            /* Compare string, to avoid hash collisions */
-            if (!strcmp(key, d->key[i])) {
-                /* Found key */
-                break ;
-            }
-        }
-    }
-    if (i>=d->size)
+    b = dictionary_locate(di, key, hash, &ix);
+    if (b<0)
         /* Key not found */
         return ;
+    i = ix->slot[b] ;
+    dictionary_set_ctrl((dict_index *)ix, (size_t)b, DICT_CTRL_DELETED);
+    if (di->sect)
+        dictionary_sect_unlink(di, i);
 
-    free(d->key[i]);
-    d->key[i] = NULL ;
-    if (d->val[i]!=NULL) {
-        free(d->val[i]);
-        d->val[i] = NULL ;
-    }
-    d->hash[i] = 0 ;
+    dictionary_strfree(di, d->key[i]);
+    dictionary_strfree(di, d->val[i]);
+    dictionary_slot_set(di, i, NULL, NULL, 0);
+    dictionary_typed_reset(di, i);
     d->n -- ;
+    if (i==d->used - 1) {
+        /* Last entry: drop it and the deleted slots before it */
+        while (d->used>0 && d->key[d->used - 1]==NULL)
+            d->used -- ;
+    }
+    dictionary_trim(di);
+    dictionary_migrate(di, DICT_MIGRATE_STEP);
     return ;
 }
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the number of sections of a dictionary.
+  @param    d       dictionary object to examine.
+  @return   Number of sections, or -1 if d has no section index.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_nsections(const dictionary * d)
+{
+    const dictionary_impl * di = (const dictionary_impl *)d ;
+
+    if (d==NULL || di->sect==NULL)
+        return -1 ;
+    return di->nsec ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find the slot of a section.
+  @param    d       dictionary object to search.
+  @param    s       Section name.
+  @return   Slot of the section entry, or -1 if not found or not indexed.
+ */
+/*--------------------------------------------------------------------------*/
+ssize_t dictionary_section_find(const dictionary * d, const char * s)
+{
+    const dictionary_impl * di = (const dictionary_impl *)d ;
+    const dict_index *  ix ;
+    ssize_t             b ;
+
+    if (d==NULL || s==NULL || di->sect==NULL || strchr(s, ':'))
+        return -1 ;
+    b = dictionary_locate(di, s, di->hashfn(s), &ix);
+    return b<0 ? -1 : (ssize_t)ix->slot[b] ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Iterate over the sections of a dictionary.
+  @param    d       dictionary object to examine.
+  @param    sec     Slot of the current section, or -1 to start.
+  @return   Slot of the next section, or -1 at the end.
+ */
+/*--------------------------------------------------------------------------*/
+ssize_t dictionary_section_next(const dictionary * d, ssize_t sec)
+{
+    const dictionary_impl * di = (const dictionary_impl *)d ;
+
+    if (d==NULL || di->sect==NULL)
+        return -1 ;
+    return sec<0 ? di->sfirst : DICT_SECT(di, sec)->next ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the number of keys of a section.
+  @param    d       dictionary object to examine.
+  @param    sec     Slot of the section.
+  @return   Number of keys of the section.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_section_nkeys(const dictionary * d, ssize_t sec)
+{
+    const dictionary_impl * di = (const dictionary_impl *)d ;
+
+    if (d==NULL || di->sect==NULL || sec<0)
+        return 0 ;
+    return DICT_SECT(di, sec)->count ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Iterate over the keys of a section.
+  @param    d       dictionary object to examine.
+  @param    sec     Slot of the section.
+  @param    slot    Slot of the current key, or -1 to start.
+  @return   Slot of the next key of the section, or -1 at the end.
+ */
+/*--------------------------------------------------------------------------*/
+ssize_t dictionary_section_key_next(const dictionary * d, ssize_t sec, ssize_t slot)
+{
+    const dictionary_impl * di = (const dictionary_impl *)d ;
+
+    if (d==NULL || di->sect==NULL || sec<0)
+        return -1 ;
+    return slot<0 ? DICT_SECT(di, sec)->first : DICT_SECT(di, slot)->next ;
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Dump a dictionary to an opened file pointer.
@@ -369,7 +2735,7 @@ void dictionary_dump(const dictionary * d, FILE * out)
         fprintf(out, "empty dictionary\n");
         return ;
     }
-    for (i=0 ; i<d->size ; i++) {
+    for (i=0 ; i<d->used ; i++) {
         if (d->key[i]) {
             fprintf(out, "%20s\t[%s]\n",
                     d->key[i],
@@ -378,3 +2744,376 @@ void dictionary_dump(const dictionary * d, FILE * out)
     }
     return ;
 }
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Add the buckets of an index to dictionary statistics
+  @param    d   Dictionary owning the index
+  @param    ix  Index to examine
+  @param    st  Statistics to update
+  @return   void
+
+  The probe length of a key is the number of groups between its home
+  bucket, hash & (size-1), and the bucket it was stored in.
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_index_stats(
+    const dictionary_impl * d,
+    const dict_index * ix,
+    dictionary_statistics * st)
+{
+    size_t      mask = ix->size - 1 ;
+    size_t      b ;
+    size_t      dist ;
+
+    for (b=0 ; b<ix->size ; b++) {
+        if (ix->ctrl[b] & DICT_CTRL_EMPTY)
+            continue ;
+        dist = (b - d->pub.hash[ix->slot[b]]) & mask ;
+        if (dist)
+            st->collisions ++ ;
+        dist /= DICT_GROUP_WIDTH ;
+        if (dist >= DICTIONARY_PROBE_BINS)
+            dist = DICTIONARY_PROBE_BINS - 1 ;
+        st->probes[dist] ++ ;
+    }
+    st->meta_bytes += ix->size * (sizeof *ix->slot + 1) + DICT_GROUP_WIDTH ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Report statistics about a dictionary.
+  @param    d   Dictionary to examine.
+  @param    st  Statistics to fill in.
+  @return   int 0 if Ok, anything else otherwise
+
+  Both indexes are walked while a resize is in progress, each key being
+  reported from the index it currently lives in. In arena mode, chunk
+  bytes not used by live strings, padding included, count as metadata.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_stats(const dictionary * d, dictionary_statistics * st)
+{
+    const dictionary_impl * di = (const dictionary_impl *)d ;
+    const dict_chunk    *   c ;
+    size_t                  held = 0 ;
+    size_t                  len ;
+    size_t                  s ;
+    ssize_t                 i ;
+
+    if (d==NULL || st==NULL) return -1 ;
+
+    memset(st, 0, sizeof *st);
+    st->n       = (size_t)d->n ;
+    st->slots   = (size_t)d->size ;
+    st->buckets = di->idx.size ;
+    st->load    = (double)di->idx.used / di->idx.size ;
+    for (i=0 ; i<d->used ; i++) {
+        if (d->key[i]==NULL)
+            continue ;
+        len = strlen(d->key[i]) + 1 ;
+        st->key_bytes += len ;
+        if (len <= DICT_ARENA_MAX)
+            held += len ;
+        if (d->val[i]==NULL)
+            continue ;
+        len = strlen(d->val[i]) + 1 ;
+        st->val_bytes += len ;
+        if (len <= DICT_ARENA_MAX && !dictionary_borrowed(di, d->val[i]))
+            held += len ;
+    }
+    st->meta_bytes = sizeof *di +
+                     (size_t)d->size * (sizeof *d->key + sizeof *d->val + sizeof *d->hash) ;
+    st->meta_bytes += (size_t)di->gsize * (sizeof *di->gkey + sizeof *di->gval + sizeof *di->ghash) ;
+    for (s=0 ; s<di->nseg ; s++) {
+        if (di->typed && di->typed[s])
+            st->meta_bytes += DICT_SEG_SIZE * sizeof **di->typed ;
+        if (di->sect && di->sect[s])
+            st->meta_bytes += DICT_SEG_SIZE * sizeof **di->sect ;
+    }
+    if (di->typed)
+        st->meta_bytes += di->nseg * sizeof *di->typed ;
+    if (di->sect)
+        st->meta_bytes += di->nseg * sizeof *di->sect ;
+    st->meta_bytes += di->osize * sizeof *di->orph ;
+    dictionary_index_stats(di, &di->idx, st);
+    if (di->old.slot)
+        dictionary_index_stats(di, &di->old, st);
+    for (c=di->chunks ; c ; c=c->next)
+        st->meta_bytes += sizeof *c + c->size ;
+    if (di->flags & DICTIONARY_ARENA)
+        st->meta_bytes -= held ;
+    st->grows      = di->grows ;
+    st->shrinks    = di->shrinks ;
+    st->gets       = di->gets ;
+    st->get_misses = di->misses ;
+    st->sets       = di->sets ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Create a frozen copy of a dictionary.
+  @param    d   Dictionary to copy.
+  @return   1 newly allocated frozen dictionary, or NULL in case of failure.
+
+  The copy is a single block indexed by a minimal perfect hash built with
+  the hash-and-displace method: keys are spread over buckets of about
+  DICT_FROZEN_LAMBDA keys, then each bucket, largest first, gets the
+  first seed which sends all its keys to distinct free slots. If some
+  bucket cannot be placed, everything is tried again with another key
+  hash seed.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary_frozen * dictionary_freeze(const dictionary * d)
+{
+    dictionary_frozen   *   f ;
+    dict_frozen_entry   *   e ;
+    uint32_t            *   seed ;
+    uint64_t            *   h ;
+    uint32_t            *   src ;
+    uint32_t            *   member ;
+    uint32_t            *   pos ;
+    uint32_t            *   start ;
+    uint32_t            *   border ;
+    unsigned char       *   taken ;
+    uint32_t                n, nb, b, j, k, s, sl, maxsz ;
+    uint64_t                gseed = 0 ;
+    size_t                  size, len ;
+    ssize_t                 i ;
+    char                *   t ;
+    int                     attempt, placed ;
+
+    if (d==NULL) return NULL ;
+
+    /* Count entries and string bytes */
+    n = 0 ;
+    len = 0 ;
+    for (i=0 ; i<d->used ; i++) {
+        if (d->key[i]==NULL)
+            continue ;
+        n++ ;
+        len += strlen(d->key[i]) + 1 ;
+        if (d->val[i])
+            len += strlen(d->val[i]) + 1 ;
+    }
+    nb = n / DICT_FROZEN_LAMBDA + 1 ;
+    size = sizeof *f + nb * sizeof *seed + n * sizeof *e + len ;
+    if (size >= DICT_FROZEN_NULL)
+        return NULL ;
+
+    f      = (dictionary_frozen*) calloc(1, size);
+    h      = (uint64_t*) malloc((n + 1) * sizeof *h);
+    src    = (uint32_t*) malloc((n + 1) * sizeof *src);
+    member = (uint32_t*) malloc((n + 1) * sizeof *member);
+    pos    = (uint32_t*) malloc((n + 1) * sizeof *pos);
+    start  = (uint32_t*) malloc((nb + 1) * sizeof *start);
+    border = (uint32_t*) malloc(nb * sizeof *border);
+    taken  = (unsigned char*) malloc(n + 1);
+    placed = 0 ;
+    if (!f || !h || !src || !member || !pos || !start || !border || !taken)
+        goto done ;
+
+    f->size  = (uint32_t)size ;
+    f->n     = n ;
+    f->nb    = nb ;
+    f->magic = DICT_FROZEN_MAGIC ;
+    f->flags = dictionary_flags(d) & DICTIONARY_NOCASE ;
+    seed    = (uint32_t*)(f + 1) ;
+    e       = (dict_frozen_entry*)(seed + nb) ;
+
+    for (j=0, i=0 ; i<d->used ; i++) {
+        if (d->key[i]!=NULL)
+            src[j++] = (uint32_t)i ;
+    }
+
+    for (attempt=0 ; attempt<DICT_FROZEN_TRIES && !placed ; attempt++) {
+        gseed = dictionary_mix64(gseed + DICT_GOLDEN) ;
+        /* Group entries by bucket */
+        memset(start, 0, (nb + 1) * sizeof *start);
+        for (j=0 ; j<n ; j++) {
+            h[j] = dictionary_hash64(d->key[src[j]], gseed, 0) ;
+            start[dictionary_range((uint32_t)(h[j] >> 32), nb) + 1]++ ;
+        }
+        maxsz = 0 ;
+        for (b=0 ; b<nb ; b++) {
+            if (start[b+1] > maxsz)
+                maxsz = start[b+1] ;
+            start[b+1] += start[b] ;
+        }
+        for (j=0 ; j<n ; j++) {
+            b = dictionary_range((uint32_t)(h[j] >> 32), nb) ;
+            member[--start[b+1]] = j ;
+        }
+        /* start[b+1] went back to start[b], shift the array down */
+        memmove(start, start + 1, nb * sizeof *start);
+        start[nb] = n ;
+        /* Order buckets by decreasing size */
+        for (k=maxsz, j=0 ; k>0 ; k--) {
+            for (b=0 ; b<nb ; b++) {
+                if (start[b+1] - start[b] == k)
+                    border[j++] = b ;
+            }
+            if (j==nb)
+                break ;
+        }
+        for (b=0 ; b<nb ; b++)
+            seed[b] = 0 ;
+        /* Place buckets */
+        memset(taken, 0, n);
+        placed = 1 ;
+        for (k=0 ; k<j && placed ; k++) {
+            b = border[k] ;
+            for (s=0 ; s<DICT_FROZEN_SEEDS ; s++) {
+                for (i=start[b] ; i<(ssize_t)start[b+1] ; i++) {
+                    sl = dictionary_frozen_slot(h[member[i]], s, n) ;
+                    if (taken[sl])
+                        break ;
+                    taken[sl] = 1 ;
+                    pos[member[i]] = sl ;
+                }
+                if (i==(ssize_t)start[b+1])
+                    break ;
+                /* Collision: release the slots of this try */
+                while (i-- > (ssize_t)start[b])
+                    taken[pos[member[i]]] = 0 ;
+            }
+            seed[b] = s ;
+            if (s==DICT_FROZEN_SEEDS)
+                placed = 0 ;
+        }
+    }
+    if (!placed)
+        goto done ;
+
+    /* Lay out entries and strings */
+    f->seed = gseed ;
+    t = (char*)(e + n) ;
+    for (j=0 ; j<n ; j++) {
+        i = src[j] ;
+        e[pos[j]].hash = (uint32_t)h[j] ;
+        e[pos[j]].key  = (uint32_t)(t - (char*)f) ;
+        len = strlen(d->key[i]) + 1 ;
+        memcpy(t, d->key[i], len);
+        t += len ;
+        if (d->val[i]==NULL) {
+            e[pos[j]].val = DICT_FROZEN_NULL ;
+            continue ;
+        }
+        e[pos[j]].val = (uint32_t)(t - (char*)f) ;
+        len = strlen(d->val[i]) + 1 ;
+        memcpy(t, d->val[i], len);
+        t += len ;
+    }
+
+done:
+    free(h);
+    free(src);
+    free(member);
+    free(pos);
+    free(start);
+    free(border);
+    free(taken);
+    if (!placed) {
+        free(f);
+        return NULL ;
+    }
+    return f ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a frozen dictionary.
+  @param    f       Frozen dictionary to search.
+  @param    key     Key to look for in the dictionary.
+  @param    def     Default value to return if key not found.
+  @return   1 pointer to a character string inside the frozen dictionary.
+
+  Looks up a key with exactly one probe: the key hash selects a bucket,
+  the bucket seed selects the only slot the key can be in, and one
+  comparison tells whether it is there. Copies of DICTIONARY_NOCASE
+  dictionaries fold the key while hashing and comparing it.
+ */
+/*--------------------------------------------------------------------------*/
+const char * dictionary_frozen_get(
+    const dictionary_frozen * f,
+    const char * key,
+    const char * def)
+{
+    const uint32_t          *   seed ;
+    const dict_frozen_entry *   e ;
+    uint64_t                    h ;
+
+    if (f==NULL || key==NULL || f->n==0)
+        return def ;
+
+    seed = (const uint32_t*)(f + 1) ;
+    h = dictionary_hash64(key, f->seed, f->flags & DICTIONARY_NOCASE) ;
+    e = (const dict_frozen_entry*)(seed + f->nb) +
+        dictionary_frozen_slot(h, seed[dictionary_range((uint32_t)(h >> 32), f->nb)], f->n) ;
+    if (e->hash != (uint32_t)h || !dictionary_keyeq(f->flags, key, (const char*)f + e->key))
+        return def ;
+    return e->val==DICT_FROZEN_NULL ? NULL : (const char*)f + e->val ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the size of a frozen dictionary.
+  @param    f   Frozen dictionary to examine.
+  @return   Size in bytes of the block starting at f, 0 if f is NULL.
+ */
+/*--------------------------------------------------------------------------*/
+size_t dictionary_frozen_size(const dictionary_frozen * f)
+{
+    return f ? f->size : 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Use a copy of a frozen dictionary block in place.
+  @param    buf     Copy of a frozen dictionary block.
+  @param    len     Size of the copy in bytes.
+  @return   buf as a frozen dictionary, or NULL if it is not a valid one.
+
+  Checks the header of the block, then that every entry refers to
+  strings inside it, the last byte of the block ending the last string.
+  Lookups then stay within the block whatever its contents.
+ */
+/*--------------------------------------------------------------------------*/
+const dictionary_frozen * dictionary_frozen_view(const void * buf, size_t len)
+{
+    const dictionary_frozen *   f = (const dictionary_frozen*)buf ;
+    const dict_frozen_entry *   e ;
+    uint64_t                    base ;
+    uint32_t                    i ;
+
+    if (f==NULL || ((uintptr_t)buf & 7) || len < sizeof *f)
+        return NULL ;
+    if (f->magic!=DICT_FROZEN_MAGIC || f->size!=len || f->nb==0 ||
+        (f->flags & ~(uint32_t)DICTIONARY_NOCASE) || f->pad!=0)
+        return NULL ;
+    base = sizeof *f + (uint64_t)f->nb * sizeof(uint32_t) +
+           (uint64_t)f->n * sizeof *e ;
+    if (base > len || (f->n>0 && ((const char*)buf)[len-1]!='\0'))
+        return NULL ;
+    e = (const dict_frozen_entry*)((const uint32_t*)(f + 1) + f->nb) ;
+    for (i=0 ; i<f->n ; i++) {
+        if (e[i].key < base || e[i].key >= len)
+            return NULL ;
+        if (e[i].val!=DICT_FROZEN_NULL && (e[i].val < base || e[i].val >= len))
+            return NULL ;
+    }
+    return f ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete a frozen dictionary.
+  @param    f   Frozen dictionary to deallocate.
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+void dictionary_frozen_del(dictionary_frozen * f)
+{
+    free(f);
+}
@@ -40,6 +40,20 @@ extern "C" {
   association is identified by a unique string key. Looking up values
   in the dictionary is speeded up by the use of a (hopefully collision-free)
   hash function.
+
+  Entries are stored in insertion order in the first used slots. Deleted
+  entries leave a NULL key behind. Iterate over entries with:
+
+    for (i=0 ; i<d->used ; i++) if (d->key[i]) ...
+
+  Only dictionary_set(), when adding a key, and dictionary_compact() move
+  entries to lower slots, keeping their order: dictionary_set() moves a
+  few at a time once deleted slots outnumber live entries, or instead of
+  growing. Other calls, dictionary_unset() included, leave entries in
+  their slots, so that the loop above may delete the entries it visits.
+  Slot arrays are copied a few slots per insertion as they grow, and
+  the key, val and hash pointers may change on any dictionary_set() or
+  dictionary_unset(), so they are read again after each call.
  */
 /*-------------------------------------------------------------------------*/
 typedef struct _dictionary_ {
@@ -48,8 +62,75 @@ typedef struct _dictionary_ {
     char        **  val ;   /** List of string values */
     char        **  key ;   /** List of string keys */
     unsigned     *  hash ;  /** List of hash values for keys */
+    ssize_t         used ;  /** Number of slots used, live or deleted */
 } dictionary ;
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Frozen dictionary object
+
+  Immutable copy of a dictionary made by dictionary_freeze(), for code
+  which reads a dictionary much more often than it changes it.
+ */
+/*-------------------------------------------------------------------------*/
+typedef struct _dictionary_frozen_ dictionary_frozen ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Hash function of dictionary keys
+
+  Must return the same value for equal strings. Only the value of
+  non-NULL keys matters.
+ */
+/*-------------------------------------------------------------------------*/
+typedef unsigned (*dictionary_hash_fn)(const char * key);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Function handing back storage lent with dictionary_borrow()
+ */
+/*-------------------------------------------------------------------------*/
+typedef void (*dictionary_release_fn)(void * base, size_t len);
+
+/** dictionary_new_flags() flag: store keys and values in an arena */
+#define DICTIONARY_ARENA    0x01
+/** dictionary_new_flags() flag: ignore the case of ASCII letters in keys */
+#define DICTIONARY_NOCASE   0x02
+/** dictionary_new_flags() flag: index the keys of each section */
+#define DICTIONARY_SECTIONS 0x04
+
+/** Number of bins of the probe length histogram of dictionary statistics */
+#define DICTIONARY_PROBE_BINS   8
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Dictionary statistics
+
+  Filled in by dictionary_stats(). Probe lengths count the groups of
+  index buckets visited to find a key, probes[i] being the number of
+  keys found after i+1 groups. The last bin also counts all longer
+  probes. The get and set counters are only maintained when
+  dictionary.c is compiled with DICTIONARY_COUNTERS defined, and stay
+  0 otherwise.
+ */
+/*-------------------------------------------------------------------------*/
+typedef struct _dictionary_statistics_ {
+    size_t      n ;          /** Number of entries */
+    size_t      slots ;      /** Number of entry slots allocated */
+    size_t      buckets ;    /** Number of index buckets */
+    double      load ;       /** Index load factor, deleted buckets included */
+    size_t      probes[DICTIONARY_PROBE_BINS] ; /** Probe length histogram */
+    size_t      collisions ; /** Keys not stored in their home bucket */
+    size_t      key_bytes ;  /** Bytes used by key strings */
+    size_t      val_bytes ;  /** Bytes used by value strings */
+    size_t      meta_bytes ; /** Bytes used by slots, index and arena slack */
+    size_t      grows ;      /** Number of times slots or index grew */
+    size_t      shrinks ;    /** Number of times slots or index shrank */
+    size_t      gets ;       /** Number of dictionary_get() calls */
+    size_t      get_misses ; /** Number of those which did not find the key */
+    size_t      sets ;       /** Number of dictionary_set() calls */
+} dictionary_statistics ;
+
 
 /*---------------------------------------------------------------------------
                             Function prototypes
@@ -61,14 +142,44 @@ typedef struct _dictionary_ {
   @param    key     Character string to use for key.
   @return   1 unsigned int on at least 32 bits.
 
-  This hash function has been taken from an Article in Dr Dobbs Journal.
-  This is normally a collision-free function, distributing keys evenly.
+  This is the default hash function of dictionaries. It reads the key
+  16 bytes at a time and mixes them with 64x64->128 bit multiplications,
+  in the manner of wyhash. The value of a key may differ between
+  platforms of different endianness.
   The key is stored anyway in the struct so that collision can be avoided
   by comparing the key itself in last resort.
  */
 /*--------------------------------------------------------------------------*/
 unsigned dictionary_hash(const char * key);
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compute the one-at-a-time hash key for a string.
+  @param    key     Character string to use for key.
+  @return   1 unsigned int on at least 32 bits.
+
+  This hash function has been taken from an Article in Dr Dobbs Journal.
+  It was the hash function of dictionaries before dictionary_hash(), and
+  can still be selected with dictionary_new_hash(). It hashes one byte
+  at a time and is therefore slow on long keys.
+ */
+/*--------------------------------------------------------------------------*/
+unsigned dictionary_hash_oat(const char * key);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compute the case-insensitive hash key for a string.
+  @param    key     Character string to use for key.
+  @return   1 unsigned int on at least 32 bits.
+
+  Same as dictionary_hash() applied to the key in lower case, without
+  copying it: ASCII letters are folded 8 bytes at a time as the key is
+  read. This is the default hash function of dictionaries created with
+  DICTIONARY_NOCASE.
+ */
+/*--------------------------------------------------------------------------*/
+unsigned dictionary_hash_nocase(const char * key);
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Create a new dictionary object.
@@ -82,6 +193,117 @@ unsigned dictionary_hash(const char * key);
 /*--------------------------------------------------------------------------*/
 dictionary * dictionary_new(size_t size);
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Create a new dictionary object with creation flags.
+  @param    size    Optional initial size of the dictionary.
+  @param    flags   Bitwise or of DICTIONARY_* flags.
+  @return   1 newly allocated dictionary objet.
+
+  Same as dictionary_new(), with the storage behaviour selected by flags.
+
+  With DICTIONARY_ARENA, keys and values are copied into a few large
+  chunks owned by the dictionary instead of one malloc() each, and
+  dictionary_del() mostly has to free those chunks. Memory used by
+  overwritten or deleted strings is reused for later strings of the same
+  size, and only given back to the system by dictionary_compact(). No
+  string moves meanwhile so that, as without an arena, strings returned
+  by dictionary_get() stay valid until their own entry is changed or
+  deleted.
+
+  With DICTIONARY_NOCASE, keys are stored in lower case and looked up
+  regardless of the case of their ASCII letters, without copying the
+  key looked for. Frozen copies of such dictionaries ignore case too.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * dictionary_new_flags(size_t size, unsigned flags);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Create a new dictionary object with its own hash function.
+  @param    size    Optional initial size of the dictionary.
+  @param    flags   Bitwise or of DICTIONARY_* flags.
+  @param    hash    Hash function of keys, NULL for dictionary_hash().
+  @return   1 newly allocated dictionary objet.
+
+  Same as dictionary_new_flags(), hashing keys with the given function.
+  The d->hash values of the dictionary are computed with it. With
+  DICTIONARY_NOCASE, the function must ignore case like
+  dictionary_hash_nocase(), the default in that case.
+ */
+/*-------------------------------------------------------------------------*/
+dictionary * dictionary_new_hash(size_t size, unsigned flags, dictionary_hash_fn hash);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the creation flags of a dictionary.
+  @param    d       dictionary object to examine.
+  @return   Bitwise or of the DICTIONARY_* flags d was created with.
+ */
+/*--------------------------------------------------------------------------*/
+unsigned dictionary_flags(const dictionary * d);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the hash function of a dictionary.
+  @param    d       dictionary object to examine.
+  @return   Function used to hash the keys of d.
+
+  Callers which look the same key up many times can hash it once with
+  this function and use the *_hashed() variants of the accessors.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary_hash_fn dictionary_hashfn(const dictionary * d);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Lend storage to a dictionary.
+  @param    d       dictionary object to modify.
+  @param    base    Start of the storage.
+  @param    len     Size of the storage in bytes.
+  @param    release Function handing the storage back, or NULL.
+  @return   int     0 if Ok, anything else otherwise
+
+  From then on, values given to dictionary_set() which lie within the
+  storage are stored as is instead of being copied, e.g. values parsed
+  in place out of a memory-mapped file. They must stay valid and
+  unchanged until dictionary_del(), which calls release(base, len) if it
+  is not NULL. A dictionary can only borrow one storage.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_borrow(dictionary * d, void * base, size_t len, dictionary_release_fn release);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Make room for a number of entries in a dictionary.
+  @param    d       dictionary object to modify.
+  @param    n       Number of entries the dictionary should hold.
+  @return   int     0 if Ok, anything else otherwise
+
+  Grows the dictionary storage and index at once so that the next
+  insertions, up to n entries in total, do not trigger any resizing.
+  Loaders can call it with an estimate of the number of entries to come.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_reserve(dictionary * d, size_t n);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Release all unused memory of a dictionary.
+  @param    d       dictionary object to compact.
+  @return   int     0 if Ok, anything else otherwise
+
+  Dictionaries already shrink by themselves as entries are deleted, with
+  some slack so that alternate insertions and deletions stay cheap. This
+  function removes all the slack at once, e.g. after loading a dictionary
+  which will no longer change. In arena mode, this is the only function
+  which moves strings: pointers previously returned by dictionary_get()
+  are no longer valid afterwards. On failure the dictionary stays usable,
+  only less compact.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_compact(dictionary * d);
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Delete a dictionary object
@@ -110,6 +332,100 @@ void dictionary_del(dictionary * vd);
 const char * dictionary_get(const dictionary * d, const char * key, const char * def);
 
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a dictionary, given the hash of its key.
+  @param    d       dictionary object to search.
+  @param    key     Key to look for in the dictionary.
+  @param    hash    Hash of key, as returned by dictionary_hashfn(d)(key).
+  @param    def     Default value to return if key not found.
+  @return   1 pointer to internally allocated character string.
+
+  Same as dictionary_get(), without hashing the key. Passing a hash which
+  is not the one of key makes the lookup fail.
+ */
+/*--------------------------------------------------------------------------*/
+const char * dictionary_get_hashed(
+    const dictionary * d,
+    const char * key,
+    unsigned hash,
+    const char * def);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a dictionary, converted to a long int.
+  @param    d         dictionary object to search.
+  @param    key       Key to look for in the dictionary.
+  @param    notfound  Value to return if key not found.
+  @return   long integer
+
+  Same as strtol(dictionary_get(d, key, ...), NULL, 0), except that the
+  converted value is cached in the dictionary entry: later calls on the
+  same key only cost a lookup until the value is changed by
+  dictionary_set(). Keys with a NULL value are reported as not found.
+
+  The cache is allocated with the dictionary and filled with atomic
+  operations, so that any number of threads may read a dictionary at the
+  same time, through these typed getters too, as long as none of them
+  modifies it.
+ */
+/*--------------------------------------------------------------------------*/
+long int dictionary_getlongint(const dictionary * d, const char * key, long int notfound);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a dictionary, converted to a double.
+  @param    d         dictionary object to search.
+  @param    key       Key to look for in the dictionary.
+  @param    notfound  Value to return if key not found.
+  @return   double
+
+  Same as atof(dictionary_get(d, key, ...)), cached like
+  dictionary_getlongint().
+ */
+/*--------------------------------------------------------------------------*/
+double dictionary_getdouble(const dictionary * d, const char * key, double notfound);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a dictionary, converted to a boolean.
+  @param    d         dictionary object to search.
+  @param    key       Key to look for in the dictionary.
+  @param    notfound  Value to return if key not found or not a boolean.
+  @return   integer
+
+  Returns 1 for values starting with one of "yYtT1", 0 for values
+  starting with one of "nNfF0", and notfound otherwise. Cached like
+  dictionary_getlongint().
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_getboolean(const dictionary * d, const char * key, int notfound);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Typed getters given the hash of the key.
+
+  Same as dictionary_getlongint(), dictionary_getdouble() and
+  dictionary_getboolean(), without hashing the key. hash must be
+  dictionary_hashfn(d)(key).
+ */
+/*--------------------------------------------------------------------------*/
+long int dictionary_getlongint_hashed(
+    const dictionary * d,
+    const char * key,
+    unsigned hash,
+    long int notfound);
+double dictionary_getdouble_hashed(
+    const dictionary * d,
+    const char * key,
+    unsigned hash,
+    double notfound);
+int dictionary_getboolean_hashed(
+    const dictionary * d,
+    const char * key,
+    unsigned hash,
+    int notfound);
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Set a value in a dictionary.
@@ -138,6 +454,20 @@ const char * dictionary_get(const dictionary * d, const char * key, const char *
 /*--------------------------------------------------------------------------*/
 int dictionary_set(dictionary * vd, const char * key, const char * val);
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set a value in a dictionary, given the hash of its key.
+  @param    d       dictionary object to modify.
+  @param    key     Key to modify or add.
+  @param    hash    Hash of key, as returned by dictionary_hashfn(d)(key).
+  @param    val     Value to add.
+  @return   int     0 if Ok, anything else otherwise
+
+  Same as dictionary_set(), without hashing the key.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_set_hashed(dictionary * d, const char * key, unsigned hash, const char * val);
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Delete a key in a dictionary
@@ -146,11 +476,92 @@ int dictionary_set(dictionary * vd, const char * key, const char * val);
   @return   void
 
   This function deletes a key in a dictionary. Nothing is done if the
-  key cannot be found.
+  key cannot be found. Other entries stay in their slots.
  */
 /*--------------------------------------------------------------------------*/
 void dictionary_unset(dictionary * d, const char * key);
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete a key in a dictionary, given the hash of the key.
+  @param    d       dictionary object to modify.
+  @param    key     Key to remove.
+  @param    hash    Hash of key, as returned by dictionary_hashfn(d)(key).
+  @return   void
+
+  Same as dictionary_unset(), without hashing the key.
+ */
+/*--------------------------------------------------------------------------*/
+void dictionary_unset_hashed(dictionary * d, const char * key, unsigned hash);
+
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the number of sections of a dictionary.
+  @param    d       dictionary object to examine.
+  @return   Number of sections, or -1 if d has no section index.
+
+  Dictionaries created with DICTIONARY_SECTIONS keep an index of their
+  sections, i.e. the keys without a colon, and of the keys of each
+  section, i.e. the keys starting with the section name and a colon.
+  Sections are listed in slot order, and so are the keys of a section.
+  The index is updated by dictionary_set() and dictionary_unset(), so
+  that the functions below cost nothing more than the entries they
+  return.
+
+  The index is optional: it is dropped if memory runs short while the
+  dictionary grows. Callers must then fall back to scanning the slots,
+  which they detect by this function returning -1.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_nsections(const dictionary * d);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find the slot of a section.
+  @param    d       dictionary object to search.
+  @param    s       Section name.
+  @return   Slot of the section entry, or -1 if not found or not indexed.
+ */
+/*--------------------------------------------------------------------------*/
+ssize_t dictionary_section_find(const dictionary * d, const char * s);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Iterate over the sections of a dictionary.
+  @param    d       dictionary object to examine.
+  @param    sec     Slot of the current section, or -1 to start.
+  @return   Slot of the next section, or -1 at the end.
+
+    for (s=dictionary_section_next(d, -1) ; s>=0 ; s=dictionary_section_next(d, s))
+        ... d->key[s] ...
+ */
+/*--------------------------------------------------------------------------*/
+ssize_t dictionary_section_next(const dictionary * d, ssize_t sec);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the number of keys of a section.
+  @param    d       dictionary object to examine.
+  @param    sec     Slot of the section.
+  @return   Number of keys of the section.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_section_nkeys(const dictionary * d, ssize_t sec);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Iterate over the keys of a section.
+  @param    d       dictionary object to examine.
+  @param    sec     Slot of the section.
+  @param    slot    Slot of the current key, or -1 to start.
+  @return   Slot of the next key of the section, or -1 at the end.
+
+  Slots stay valid until the next dictionary_set() or dictionary_compact()
+  call on the dictionary, or until their own entry is deleted.
+ */
+/*--------------------------------------------------------------------------*/
+ssize_t dictionary_section_key_next(const dictionary * d, ssize_t sec, ssize_t slot);
 
 /*-------------------------------------------------------------------------*/
 /**
@@ -160,12 +571,105 @@ void dictionary_unset(dictionary * d, const char * key);
   @return   void
 
   Dumps a dictionary onto an opened file pointer. Key pairs are printed out
-  as @c [Key]=[Value], one per line. It is Ok to provide stdout or stderr as
-  output file pointers.
+  as @c [Key]=[Value], one per line, in insertion order. It is Ok to provide
+  stdout or stderr as output file pointers.
  */
 /*--------------------------------------------------------------------------*/
 void dictionary_dump(const dictionary * d, FILE * out);
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Report statistics about a dictionary.
+  @param    d   Dictionary to examine.
+  @param    st  Statistics to fill in.
+  @return   int 0 if Ok, anything else otherwise
+
+  Measures how a dictionary is laid out: load of its index, length of
+  the probe sequences of its keys, memory used, and how often it was
+  resized. This walks the whole index, it is meant for diagnostics and
+  not for hot paths.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_stats(const dictionary * d, dictionary_statistics * st);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Create a frozen copy of a dictionary.
+  @param    d   Dictionary to copy.
+  @return   1 newly allocated frozen dictionary, or NULL in case of failure.
+
+  This function builds an immutable copy of a dictionary in a single
+  memory block, indexed by a minimal perfect hash function so that any
+  lookup in the copy costs exactly one probe. Building the copy is
+  slower than copying the dictionary, and later changes to d are not
+  reflected in it: freeze a dictionary once it has been loaded, and
+  freeze it again after modifying it.
+
+  The returned object must be freed with dictionary_frozen_del().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary_frozen * dictionary_freeze(const dictionary * d);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a frozen dictionary.
+  @param    f       Frozen dictionary to search.
+  @param    key     Key to look for in the dictionary.
+  @param    def     Default value to return if key not found.
+  @return   1 pointer to a character string inside the frozen dictionary.
+
+  This function behaves like dictionary_get() on the dictionary the frozen
+  copy was made from. The returned string stays valid until the frozen
+  dictionary is deleted. A frozen dictionary is never modified, so any
+  number of threads may read it at the same time.
+ */
+/*--------------------------------------------------------------------------*/
+const char * dictionary_frozen_get(
+    const dictionary_frozen * f,
+    const char * key,
+    const char * def);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the size of a frozen dictionary.
+  @param    f   Frozen dictionary to examine.
+  @return   Size in bytes of the block starting at f, 0 if f is NULL.
+
+  A frozen dictionary is a single block which does not depend on its
+  address: these bytes can be stored as they are, e.g. in a file, and
+  used again through dictionary_frozen_view().
+ */
+/*--------------------------------------------------------------------------*/
+size_t dictionary_frozen_size(const dictionary_frozen * f);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Use a copy of a frozen dictionary block in place.
+  @param    buf     Copy of a frozen dictionary block.
+  @param    len     Size of the copy in bytes.
+  @return   buf as a frozen dictionary, or NULL if it is not a valid one.
+
+  Validates len bytes saved from a frozen dictionary, on a machine of
+  the same byte order and by the same version of this module, and
+  returns them as a frozen dictionary without copying anything. buf
+  must be aligned on 8 bytes, as malloc() and mmap() memory is. The
+  result stays valid as long as buf, and must not be passed to
+  dictionary_frozen_del().
+
+  Validation costs one pass over the entries, not over the strings.
+ */
+/*--------------------------------------------------------------------------*/
+const dictionary_frozen * dictionary_frozen_view(const void * buf, size_t len);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete a frozen dictionary.
+  @param    f   Frozen dictionary to deallocate.
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+void dictionary_frozen_del(dictionary_frozen * f);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,345 @@
+/*-------------------------------------------------------------------------*/
+/**
+   @file    dictionary_rcu.c
+   @brief   Dictionary shared between one writer and lock-free readers.
+
+   Readers announce themselves in a reader slot, tagged with the epoch
+   they started in. Each publication advances the epoch and retires the
+   replaced snapshot with the new epoch: a reader whose slot shows an
+   older epoch may still hold it, any later reader cannot. Retired
+   snapshots are deleted once every busy reader slot shows an epoch at
+   least as recent as theirs.
+*/
+/*--------------------------------------------------------------------------*/
+
+/*---------------------------------------------------------------------------
+                                Includes
+ ---------------------------------------------------------------------------*/
+#include "dictionary_rcu.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+/** Number of reader slots, the maximum number of concurrent readers */
+#define DICT_RCU_SLOTS      64
+
+/** Size of a cache line, reader slots are padded to it */
+#define DICT_RCU_LINE       64
+
+/*---------------------------------------------------------------------------
+                                Private types
+ ---------------------------------------------------------------------------*/
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Reader slot
+
+  Holds the epoch a reader started in, or 0 when free. Each slot has its
+  own cache line so that readers do not slow each other down.
+ */
+/*-------------------------------------------------------------------------*/
+typedef struct _dict_rcu_slot_ {
+    _Atomic uint64_t    epoch ;
+    char                pad[DICT_RCU_LINE - sizeof(uint64_t)] ;
+} dict_rcu_slot ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Retired snapshot, waiting for its readers to leave
+ */
+/*-------------------------------------------------------------------------*/
+typedef struct _dict_rcu_retired_ {
+    struct _dict_rcu_retired_ * next ;
+    dictionary_frozen       *   snap ;
+    uint64_t                    epoch ;  /** Epoch it was retired in */
+} dict_rcu_retired ;
+
+struct _dictionary_rcu_ {
+    dict_rcu_slot                   slot[DICT_RCU_SLOTS] ;
+    _Atomic(dictionary_frozen *)    cur ;     /** Published snapshot */
+    _Atomic uint64_t                epoch ;   /** Current epoch, from 1 */
+    pthread_mutex_t                 lock ;    /** Serializes writers */
+    dictionary                  *   d ;       /** Writers' dictionary */
+    dict_rcu_retired            *   retired ; /** Snapshots to delete */
+} ;
+
+/*---------------------------------------------------------------------------
+                            Private functions
+ ---------------------------------------------------------------------------*/
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete the retired snapshots no reader can be using
+  @param    r   Shared dictionary, with the write lock held
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+static void dictionary_rcu_reclaim(dictionary_rcu * r)
+{
+    dict_rcu_retired    **  p ;
+    dict_rcu_retired    *   q ;
+    uint64_t                oldest = UINT64_MAX ;
+    uint64_t                e ;
+    int                     i ;
+
+    for (i=0 ; i<DICT_RCU_SLOTS ; i++) {
+        e = atomic_load(&r->slot[i].epoch);
+        if (e!=0 && e<oldest)
+            oldest = e ;
+    }
+    for (p = &r->retired ; *p ; ) {
+        q = *p ;
+        if (q->epoch <= oldest) {
+            *p = q->next ;
+            dictionary_frozen_del(q->snap);
+            free(q);
+        } else {
+            p = &q->next ;
+        }
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Publish a new snapshot of the writers' dictionary
+  @param    r   Shared dictionary, with the write lock held
+  @return   int 0 if Ok, anything else otherwise
+ */
+/*--------------------------------------------------------------------------*/
+static int dictionary_rcu_publish(dictionary_rcu * r)
+{
+    dictionary_frozen   *   f ;
+    dict_rcu_retired    *   q ;
+
+    f = dictionary_freeze(r->d);
+    q = (dict_rcu_retired*) malloc(sizeof *q);
+    if (!f || !q) {
+        dictionary_frozen_del(f);
+        free(q);
+        return -1 ;
+    }
+    q->snap  = atomic_exchange(&r->cur, f);
+    q->epoch = atomic_fetch_add(&r->epoch, 1) + 1 ;
+    q->next  = r->retired ;
+    r->retired = q ;
+    dictionary_rcu_reclaim(r);
+    return 0 ;
+}
+
+/*---------------------------------------------------------------------------
+                            Function codes
+ ---------------------------------------------------------------------------*/
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Create a shared dictionary.
+  @param    d   Dictionary holding the initial contents.
+  @return   1 newly allocated shared dictionary, or NULL in case of failure.
+
+  The shared dictionary takes ownership of d, which must no longer be
+  used directly by the caller. A first snapshot of d is published before
+  this function returns.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary_rcu * dictionary_rcu_new(dictionary * d)
+{
+    dictionary_rcu  *   r ;
+    int                 i ;
+
+    if (d==NULL) return NULL ;
+
+    r = (dictionary_rcu*) calloc(1, sizeof *r);
+    if (!r)
+        return NULL ;
+    for (i=0 ; i<DICT_RCU_SLOTS ; i++)
+        atomic_init(&r->slot[i].epoch, 0);
+    atomic_init(&r->epoch, 1);
+    atomic_init(&r->cur, dictionary_freeze(d));
+    if (atomic_load(&r->cur)==NULL ||
+        pthread_mutex_init(&r->lock, NULL) != 0) {
+        dictionary_frozen_del(atomic_load(&r->cur));
+        free(r);
+        return NULL ;
+    }
+    r->d = d ;
+    return r ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete a shared dictionary.
+  @param    r   Shared dictionary to deallocate.
+  @return   void
+
+  Deallocates the dictionary and all its snapshots. No reader or writer
+  may be using it anymore.
+ */
+/*--------------------------------------------------------------------------*/
+void dictionary_rcu_del(dictionary_rcu * r)
+{
+    dict_rcu_retired    *   q ;
+
+    if (r==NULL) return ;
+    while ((q = r->retired) != NULL) {
+        r->retired = q->next ;
+        dictionary_frozen_del(q->snap);
+        free(q);
+    }
+    dictionary_frozen_del(atomic_load(&r->cur));
+    dictionary_del(r->d);
+    pthread_mutex_destroy(&r->lock);
+    free(r);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Start reading a shared dictionary.
+  @param    r       Shared dictionary to read.
+  @param    slot    Receives the reader slot to pass to read_unlock.
+  @return   The current snapshot of the dictionary.
+
+  The reader slot is claimed before the snapshot is loaded: a writer
+  which misses the claim has already published a newer snapshot, which
+  is the one the reader gets.
+ */
+/*--------------------------------------------------------------------------*/
+const dictionary_frozen * dictionary_rcu_read_lock(dictionary_rcu * r, int * slot)
+{
+    static _Thread_local unsigned   hint ;
+    uint64_t                        e ;
+    uint64_t                        free_epoch ;
+    unsigned                        i ;
+
+    /* Start from a slot which depends on the thread, to spread readers */
+    if (hint==0)
+        hint = (unsigned)((uintptr_t)&hint / DICT_RCU_LINE) | 1u ;
+    for (i=hint ; ; i++) {
+        free_epoch = 0 ;
+        e = atomic_load(&r->epoch);
+        if (atomic_compare_exchange_strong(&r->slot[i % DICT_RCU_SLOTS].epoch,
+                                           &free_epoch, e))
+            break ;
+        /* All slots busy: let other readers finish */
+        if ((i - hint) % DICT_RCU_SLOTS == DICT_RCU_SLOTS - 1)
+            sched_yield();
+    }
+    *slot = (int)(i % DICT_RCU_SLOTS) ;
+    return atomic_load(&r->cur);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Stop reading a shared dictionary.
+  @param    r       Shared dictionary being read.
+  @param    slot    Reader slot returned by dictionary_rcu_read_lock().
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+void dictionary_rcu_read_unlock(dictionary_rcu * r, int slot)
+{
+    atomic_store(&r->slot[slot].epoch, 0);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a shared dictionary.
+  @param    r       Shared dictionary to search.
+  @param    key     Key to look for in the dictionary.
+  @param    def     Default value to return if key not found.
+  @param    buf     Buffer receiving a copy of the value.
+  @param    len     Size of buf.
+  @return   buf, def if key was not found, or NULL if the value is NULL.
+ */
+/*--------------------------------------------------------------------------*/
+const char * dictionary_rcu_get(
+    dictionary_rcu * r,
+    const char * key,
+    const char * def,
+    char * buf,
+    size_t len)
+{
+    const dictionary_frozen *   f ;
+    const char              *   val ;
+    int                         slot ;
+
+    if (r==NULL || key==NULL || buf==NULL || len==0)
+        return def ;
+
+    f = dictionary_rcu_read_lock(r, &slot);
+    val = dictionary_frozen_get(f, key, def);
+    if (val!=NULL && val!=def) {
+        strncpy(buf, val, len - 1);
+        buf[len - 1] = '\0' ;
+        val = buf ;
+    }
+    dictionary_rcu_read_unlock(r, slot);
+    return val ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Start modifying a shared dictionary.
+  @param    r   Shared dictionary to modify.
+  @return   The private dictionary of writers.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * dictionary_rcu_write_lock(dictionary_rcu * r)
+{
+    pthread_mutex_lock(&r->lock);
+    return r->d ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Publish the changes made to a shared dictionary.
+  @param    r   Shared dictionary being modified.
+  @return   int 0 if Ok, anything else otherwise
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_rcu_write_unlock(dictionary_rcu * r)
+{
+    int ret ;
+
+    ret = dictionary_rcu_publish(r);
+    pthread_mutex_unlock(&r->lock);
+    return ret ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set a value in a shared dictionary.
+  @param    r       Shared dictionary to modify.
+  @param    key     Key to modify or add.
+  @param    val     Value to add.
+  @return   int     0 if Ok, anything else otherwise
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_rcu_set(dictionary_rcu * r, const char * key, const char * val)
+{
+    int ret ;
+
+    if (r==NULL || key==NULL) return -1 ;
+
+    ret = dictionary_set(dictionary_rcu_write_lock(r), key, val);
+    if (dictionary_rcu_write_unlock(r) != 0)
+        ret = -1 ;
+    return ret ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete a key in a shared dictionary.
+  @param    r       Shared dictionary to modify.
+  @param    key     Key to remove.
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+void dictionary_rcu_unset(dictionary_rcu * r, const char * key)
+{
+    if (r==NULL || key==NULL) return ;
+
+    dictionary_unset(dictionary_rcu_write_lock(r), key);
+    dictionary_rcu_write_unlock(r);
+}
@@ -0,0 +1,181 @@
+/*-------------------------------------------------------------------------*/
+/**
+   @file    dictionary_rcu.h
+   @brief   Dictionary shared between one writer and lock-free readers.
+
+   This module wraps a dictionary so that it can be read from any number
+   of threads while another thread modifies it. Writers work on a private
+   dictionary and publish frozen snapshots of it. Readers only ever see
+   complete snapshots and never take a lock: they pick up the current
+   snapshot, use it, and release it. A snapshot replaced by a newer one
+   is deleted once no reader can still be using it.
+
+   This module needs C11 atomics and POSIX threads.
+*/
+/*--------------------------------------------------------------------------*/
+
+#ifndef _DICTIONARY_RCU_H_
+#define _DICTIONARY_RCU_H_
+
+/*---------------------------------------------------------------------------
+                                Includes
+ ---------------------------------------------------------------------------*/
+
+#include "dictionary.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------
+                                New types
+ ---------------------------------------------------------------------------*/
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Shared dictionary object
+
+  Holds the dictionary modified by writers and the snapshot currently
+  published to readers.
+ */
+/*-------------------------------------------------------------------------*/
+typedef struct _dictionary_rcu_ dictionary_rcu ;
+
+/*---------------------------------------------------------------------------
+                            Function prototypes
+ ---------------------------------------------------------------------------*/
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Create a shared dictionary.
+  @param    d   Dictionary holding the initial contents.
+  @return   1 newly allocated shared dictionary, or NULL in case of failure.
+
+  The shared dictionary takes ownership of d, which must no longer be
+  used directly by the caller. A first snapshot of d is published before
+  this function returns.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary_rcu * dictionary_rcu_new(dictionary * d);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete a shared dictionary.
+  @param    r   Shared dictionary to deallocate.
+  @return   void
+
+  Deallocates the dictionary and all its snapshots. No reader or writer
+  may be using it anymore.
+ */
+/*--------------------------------------------------------------------------*/
+void dictionary_rcu_del(dictionary_rcu * r);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Start reading a shared dictionary.
+  @param    r       Shared dictionary to read.
+  @param    slot    Receives the reader slot to pass to read_unlock.
+  @return   The current snapshot of the dictionary.
+
+  The returned snapshot can be searched with dictionary_frozen_get() and
+  stays valid, and unchanged, until dictionary_rcu_read_unlock() is
+  called. This function never blocks on writers. Readers should not keep
+  a snapshot for long, as it delays the release of older snapshots.
+ */
+/*--------------------------------------------------------------------------*/
+const dictionary_frozen * dictionary_rcu_read_lock(dictionary_rcu * r, int * slot);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Stop reading a shared dictionary.
+  @param    r       Shared dictionary being read.
+  @param    slot    Reader slot returned by dictionary_rcu_read_lock().
+  @return   void
+
+  The snapshot obtained with the matching read_lock call must not be
+  used anymore.
+ */
+/*--------------------------------------------------------------------------*/
+void dictionary_rcu_read_unlock(dictionary_rcu * r, int slot);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a shared dictionary.
+  @param    r       Shared dictionary to search.
+  @param    key     Key to look for in the dictionary.
+  @param    def     Default value to return if key not found.
+  @param    buf     Buffer receiving a copy of the value.
+  @param    len     Size of buf.
+  @return   buf, def if key was not found, or NULL if the value is NULL.
+
+  Convenience wrapper copying a value out of the current snapshot, for
+  callers which do not want to hold a snapshot. Values longer than len-1
+  characters are truncated.
+ */
+/*--------------------------------------------------------------------------*/
+const char * dictionary_rcu_get(
+    dictionary_rcu * r,
+    const char * key,
+    const char * def,
+    char * buf,
+    size_t len);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Start modifying a shared dictionary.
+  @param    r   Shared dictionary to modify.
+  @return   The private dictionary of writers.
+
+  Writers are serialized: this function waits for other writers to call
+  dictionary_rcu_write_unlock(). The returned dictionary may be modified
+  with any dictionary or iniparser function until then. Readers keep
+  seeing the previous snapshot.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * dictionary_rcu_write_lock(dictionary_rcu * r);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Publish the changes made to a shared dictionary.
+  @param    r   Shared dictionary being modified.
+  @return   int 0 if Ok, anything else otherwise
+
+  Freezes the private dictionary of writers and makes the result the
+  current snapshot, then releases the write lock. Snapshots no reader
+  uses anymore are deleted. If the snapshot cannot be built, readers
+  keep the previous one and this function returns non-zero.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_rcu_write_unlock(dictionary_rcu * r);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set a value in a shared dictionary.
+  @param    r       Shared dictionary to modify.
+  @param    key     Key to modify or add.
+  @param    val     Value to add.
+  @return   int     0 if Ok, anything else otherwise
+
+  Same as dictionary_set() followed by publishing a new snapshot. Use
+  dictionary_rcu_write_lock() to publish many changes at once.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_rcu_set(dictionary_rcu * r, const char * key, const char * val);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete a key in a shared dictionary.
+  @param    r       Shared dictionary to modify.
+  @param    key     Key to remove.
+  @return   void
+
+  Same as dictionary_unset() followed by publishing a new snapshot.
+ */
+/*--------------------------------------------------------------------------*/
+void dictionary_rcu_unset(dictionary_rcu * r, const char * key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,282 @@
+/*-------------------------------------------------------------------------*/
+/**
+   @file    dictionary_shard.c
+   @brief   Dictionary partitioned in lock-striped shards.
+
+   The shard of a key is taken from the top bits of its hash multiplied
+   by a large odd constant. Shards index keys by the low bits of the same
+   hash, which must therefore stay evenly spread within a shard: using a
+   plain bit range of the hash for both would crowd each shard into a
+   fraction of its index buckets.
+*/
+/*--------------------------------------------------------------------------*/
+
+/*---------------------------------------------------------------------------
+                                Includes
+ ---------------------------------------------------------------------------*/
+#include "dictionary_shard.h"
+
+#include <pthread.h>
+
+/** Largest number of shards */
+#define DICT_SHARD_MAX      1024
+
+/** Size of a cache line, shards are padded to it */
+#define DICT_SHARD_LINE     64
+
+/*---------------------------------------------------------------------------
+                                Private types
+ ---------------------------------------------------------------------------*/
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Shard: one dictionary and its lock
+
+  Shards are padded to a whole number of cache lines, and the array of
+  shards starts on a cache line, so that threads locking neighbouring
+  shards do not slow each other down.
+ */
+/*-------------------------------------------------------------------------*/
+typedef struct _dict_shard_ {
+    pthread_mutex_t     lock ;
+    dictionary      *   d ;
+    char                pad[DICT_SHARD_LINE -
+                            (sizeof(pthread_mutex_t) + sizeof(dictionary*))
+                            % DICT_SHARD_LINE] ;
+} dict_shard ;
+
+struct _dictionary_sharded_ {
+    unsigned            nshards ;   /** Number of shards, a power of 2 */
+    unsigned            shift ;     /** 32 - log2(nshards) */
+    unsigned            flags ;     /** DICTIONARY_* flags of the shards */
+    dictionary_hash_fn  hash ;      /** Hash function of the shards */
+    dict_shard      *   shard ;
+} ;
+
+/*---------------------------------------------------------------------------
+                            Private functions
+ ---------------------------------------------------------------------------*/
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find the shard of a key
+  @param    ds      Sharded dictionary
+  @param    key     Key to look for
+  @param    hash    Receives the hash of key for the *_hashed() accessors
+  @return   Shard holding key, if present
+
+  The key is hashed once, with the hash function of the shards, for both
+  picking the shard and looking the key up in it.
+ */
+/*--------------------------------------------------------------------------*/
+static dict_shard * dictionary_shard_of(
+    const dictionary_sharded * ds,
+    const char * key,
+    unsigned * hash)
+{
+    unsigned h ;
+
+    *hash = ds->hash(key);
+    h = *hash * 0x9E3779B1u ;
+    return ds->shard + (ds->nshards > 1 ? h >> ds->shift : 0) ;
+}
+
+/*---------------------------------------------------------------------------
+                            Function codes
+ ---------------------------------------------------------------------------*/
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Create a new sharded dictionary.
+  @param    nshards Number of shards, rounded up to a power of 2.
+  @param    size    Optional initial size of the whole dictionary.
+  @param    flags   Bitwise or of DICTIONARY_* flags for every shard.
+  @return   1 newly allocated sharded dictionary, or NULL on failure.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary_sharded * dictionary_sharded_new(unsigned nshards, size_t size, unsigned flags)
+{
+    dictionary_sharded  *   ds ;
+    void                *   shard ;
+    unsigned                n, i ;
+    long                    ncpu ;
+
+    if (nshards==0) {
+        ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        nshards = ncpu > 0 ? (unsigned)ncpu * 4 : 16 ;
+    }
+    if (nshards > DICT_SHARD_MAX)
+        nshards = DICT_SHARD_MAX ;
+    for (n=1, i=32 ; n<nshards ; n*=2, i--)
+        ;
+
+    ds = (dictionary_sharded*) calloc(1, sizeof *ds);
+    if (!ds)
+        return NULL ;
+    ds->nshards = n ;
+    ds->shift   = i ;
+    ds->flags   = flags ;
+    if (posix_memalign(&shard, DICT_SHARD_LINE, n * sizeof *ds->shard) != 0) {
+        free(ds);
+        return NULL ;
+    }
+    ds->shard   = (dict_shard*) memset(shard, 0, n * sizeof *ds->shard);
+    for (i=0 ; i<n ; i++) {
+        ds->shard[i].d = dictionary_new_flags(size / n, flags);
+        if (ds->shard[i].d==NULL ||
+            pthread_mutex_init(&ds->shard[i].lock, NULL) != 0) {
+            dictionary_del(ds->shard[i].d);
+            ds->nshards = i ;
+            dictionary_sharded_del(ds);
+            return NULL ;
+        }
+    }
+    ds->hash = dictionary_hashfn(ds->shard[0].d);
+    return ds ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete a sharded dictionary.
+  @param    ds  Sharded dictionary to deallocate.
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+void dictionary_sharded_del(dictionary_sharded * ds)
+{
+    unsigned i ;
+
+    if (ds==NULL) return ;
+    for (i=0 ; i<ds->nshards ; i++) {
+        dictionary_del(ds->shard[i].d);
+        pthread_mutex_destroy(&ds->shard[i].lock);
+    }
+    free(ds->shard);
+    free(ds);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a sharded dictionary.
+  @param    ds      Sharded dictionary to search.
+  @param    key     Key to look for in the dictionary.
+  @param    def     Default value to return if key not found.
+  @param    buf     Buffer receiving a copy of the value.
+  @param    len     Size of buf.
+  @return   buf, def if key was not found, or NULL if the value is NULL.
+ */
+/*--------------------------------------------------------------------------*/
+const char * dictionary_sharded_get(
+    dictionary_sharded * ds,
+    const char * key,
+    const char * def,
+    char * buf,
+    size_t len)
+{
+    dict_shard  *   s ;
+    const char  *   val ;
+    unsigned        hash ;
+
+    if (ds==NULL || key==NULL || buf==NULL || len==0)
+        return def ;
+
+    s = dictionary_shard_of(ds, key, &hash);
+    pthread_mutex_lock(&s->lock);
+    val = dictionary_get_hashed(s->d, key, hash, def);
+    if (val!=NULL && val!=def) {
+        strncpy(buf, val, len - 1);
+        buf[len - 1] = '\0' ;
+        val = buf ;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return val ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set a value in a sharded dictionary.
+  @param    ds      Sharded dictionary to modify.
+  @param    key     Key to modify or add.
+  @param    val     Value to add.
+  @return   int     0 if Ok, anything else otherwise
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_sharded_set(dictionary_sharded * ds, const char * key, const char * val)
+{
+    dict_shard  *   s ;
+    unsigned        hash ;
+    int             ret ;
+
+    if (ds==NULL || key==NULL) return -1 ;
+
+    s = dictionary_shard_of(ds, key, &hash);
+    pthread_mutex_lock(&s->lock);
+    ret = dictionary_set_hashed(s->d, key, hash, val);
+    pthread_mutex_unlock(&s->lock);
+    return ret ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete a key in a sharded dictionary.
+  @param    ds      Sharded dictionary to modify.
+  @param    key     Key to remove.
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+void dictionary_sharded_unset(dictionary_sharded * ds, const char * key)
+{
+    dict_shard  *   s ;
+    unsigned        hash ;
+
+    if (ds==NULL || key==NULL) return ;
+
+    s = dictionary_shard_of(ds, key, &hash);
+    pthread_mutex_lock(&s->lock);
+    dictionary_unset_hashed(s->d, key, hash);
+    pthread_mutex_unlock(&s->lock);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Copy a sharded dictionary into a plain dictionary.
+  @param    ds  Sharded dictionary to copy.
+  @return   1 newly allocated dictionary, or NULL in case of failure.
+
+  Shards are locked in increasing order, which cannot deadlock with the
+  other functions as they never hold more than one shard lock. The copy
+  is made with the flags of the shards, and takes their entries shard
+  after shard, each one in its own order.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * dictionary_sharded_merge(dictionary_sharded * ds)
+{
+    dictionary  *   d ;
+    dictionary  *   s ;
+    unsigned        i ;
+    ssize_t         j ;
+    size_t          n = 0 ;
+    int             err = 0 ;
+
+    if (ds==NULL) return NULL ;
+
+    for (i=0 ; i<ds->nshards ; i++) {
+        pthread_mutex_lock(&ds->shard[i].lock);
+        n += (size_t)ds->shard[i].d->n ;
+    }
+    d = dictionary_new_flags(n, ds->flags);
+    for (i=0 ; i<ds->nshards && d ; i++) {
+        s = ds->shard[i].d ;
+        for (j=0 ; j<s->used && !err ; j++) {
+            if (s->key[j]!=NULL)
+                err = dictionary_set(d, s->key[j], s->val[j]);
+        }
+    }
+    for (i=0 ; i<ds->nshards ; i++)
+        pthread_mutex_unlock(&ds->shard[i].lock);
+    if (err) {
+        dictionary_del(d);
+        d = NULL ;
+    }
+    return d ;
+}
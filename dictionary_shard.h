@@ -0,0 +1,139 @@
+/*-------------------------------------------------------------------------*/
+/**
+   @file    dictionary_shard.h
+   @brief   Dictionary partitioned in lock-striped shards.
+
+   This module implements a dictionary which any number of threads may
+   read and modify at the same time. Keys are spread over a power of 2
+   number of shards by their hash, and each shard is a plain dictionary
+   protected by its own lock: threads working on keys in different
+   shards never wait for each other.
+
+   This module needs POSIX threads.
+*/
+/*--------------------------------------------------------------------------*/
+
+#ifndef _DICTIONARY_SHARD_H_
+#define _DICTIONARY_SHARD_H_
+
+/*---------------------------------------------------------------------------
+                                Includes
+ ---------------------------------------------------------------------------*/
+
+#include "dictionary.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------
+                                New types
+ ---------------------------------------------------------------------------*/
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Sharded dictionary object
+ */
+/*-------------------------------------------------------------------------*/
+typedef struct _dictionary_sharded_ dictionary_sharded ;
+
+/*---------------------------------------------------------------------------
+                            Function prototypes
+ ---------------------------------------------------------------------------*/
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Create a new sharded dictionary.
+  @param    nshards Number of shards, rounded up to a power of 2.
+  @param    size    Optional initial size of the whole dictionary.
+  @param    flags   Bitwise or of DICTIONARY_* flags for every shard.
+  @return   1 newly allocated sharded dictionary, or NULL on failure.
+
+  Give nshards=0 to use four shards per online processor, which keeps
+  lock collisions rare for as many writer threads as processors.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary_sharded * dictionary_sharded_new(unsigned nshards, size_t size, unsigned flags);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete a sharded dictionary.
+  @param    ds  Sharded dictionary to deallocate.
+  @return   void
+
+  No other thread may be using the dictionary anymore.
+ */
+/*--------------------------------------------------------------------------*/
+void dictionary_sharded_del(dictionary_sharded * ds);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a value from a sharded dictionary.
+  @param    ds      Sharded dictionary to search.
+  @param    key     Key to look for in the dictionary.
+  @param    def     Default value to return if key not found.
+  @param    buf     Buffer receiving a copy of the value.
+  @param    len     Size of buf.
+  @return   buf, def if key was not found, or NULL if the value is NULL.
+
+  Another thread may change the value as soon as the shard lock is
+  released, so the value is copied to buf under the lock. Values longer
+  than len-1 characters are truncated.
+ */
+/*--------------------------------------------------------------------------*/
+const char * dictionary_sharded_get(
+    dictionary_sharded * ds,
+    const char * key,
+    const char * def,
+    char * buf,
+    size_t len);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set a value in a sharded dictionary.
+  @param    ds      Sharded dictionary to modify.
+  @param    key     Key to modify or add.
+  @param    val     Value to add.
+  @return   int     0 if Ok, anything else otherwise
+
+  Same as dictionary_set(), only locking the shard of key.
+ */
+/*--------------------------------------------------------------------------*/
+int dictionary_sharded_set(dictionary_sharded * ds, const char * key, const char * val);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete a key in a sharded dictionary.
+  @param    ds      Sharded dictionary to modify.
+  @param    key     Key to remove.
+  @return   void
+
+  Same as dictionary_unset(), only locking the shard of key.
+ */
+/*--------------------------------------------------------------------------*/
+void dictionary_sharded_unset(dictionary_sharded * ds, const char * key);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Copy a sharded dictionary into a plain dictionary.
+  @param    ds  Sharded dictionary to copy.
+  @return   1 newly allocated dictionary, or NULL in case of failure.
+
+  All shards are locked during the copy, which is therefore a consistent
+  view of the whole dictionary. Use it e.g. to save the dictionary with
+  iniparser_dump_ini(). Free the result with dictionary_del().
+
+  The copy has the DICTIONARY_* flags of the shards. Its entries come
+  shard after shard, each shard in the order its keys were first set:
+  the order in which keys of different shards were set is lost, so
+  sections, and keys within a section, come in no particular order.
+  iniparser_dump_ini() still writes each key under its section.
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * dictionary_sharded_merge(dictionary_sharded * ds);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,212 @@
+// Build command: gcc -O2 doc-test.c dictionary.c iniparser.c -o doc-test -lpthread
+
+/* Regression tests for iniparser_doc_save: each case writes an ini file,
+ * sets and deletes keys through an iniparser_doc_t, saves it both in
+ * place and by rewriting, then checks the exact text saved, that
+ * iniparser_load reads back every change, and that loading the saved
+ * file as a document and saving it again leaves it byte for byte.
+ *
+ * Prints one line per failing case; the exit status is the number of
+ * failures. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "iniparser.h"
+
+struct doc_op
+{
+  const char *key;
+  const char *val;              /* NULL deletes the key */
+};
+
+struct doc_case
+{
+  const char *name;
+  const char *text;             /* File before the save */
+  struct doc_op ops[3];         /* Changes, up to a NULL key */
+  const char *expect;           /* File after the save */
+  const char *inplace;          /* Same with INIPARSER_SAVE_INPLACE, if
+                                   different */
+};
+
+static const struct doc_case cases[] = {
+  /* The value edit of the last line and the keys inserted after it both
+   * land at the end of the file, the value must come first */
+  {"empty last value, no final newline, same section",
+   "[a]\nk =", {{"a:k", "1"}, {"a:y", "2"}},
+   "[a]\nk = 1\ny = 2\n"},
+  {"empty last value, no final newline, new section",
+   "[a]\nk =", {{"a:k", "1"}, {"b:x", "2"}},
+   "[a]\nk = 1\n\n[b]\nx = 2\n"},
+  {"last value, no final newline",
+   "[a]\nk = x", {{"a:k", "1"}, {"a:y", "2"}},
+   "[a]\nk = 1\ny = 2\n"},
+  {"empty last value",
+   "[a]\nk =\n", {{"a:k", "1"}, {"a:y", "2"}},
+   "[a]\nk = 1\ny = 2\n"},
+  /* Lossless round trips: everything not changed stays as it was */
+  {"comments kept",
+   "; head\n[a]\n\n# note\nk = old ; why\nz = 1 # last\n",
+   {{"a:k", "new"}},
+   "; head\n[a]\n\n# note\nk = new ; why\nz = 1 # last\n"},
+  {"quoted values kept",
+   "[a]\nq = \"x ; y\"\nr = ' keep '\nk = 1\n",
+   {{"a:k", "2"}},
+   "[a]\nq = \"x ; y\"\nr = ' keep '\nk = 2\n"},
+  {"value quoted when it needs it",
+   "[a]\nq = \"x ; y\"\nk = 1\n",
+   {{"a:q", "u ; v"}},
+   "[a]\nq = \"u ; v\"\nk = 1\n"},
+  {"values set to what they were",
+   "[a]\nq = \"x ; y\"\nk = 1 ; c\n",
+   {{"a:q", "x ; y"}, {"a:k", "1"}},
+   "[a]\nq = \"x ; y\"\nk = 1 ; c\n"},
+  {"joined lines kept",
+   "[a]\nj = one \\\n  two\nk = 1\n",
+   {{"a:k", "2"}},
+   "[a]\nj = one \\\n  two\nk = 2\n"},
+  {"joined lines set",
+   "[a]\nj = one \\\n  two\nk = 1\n",
+   {{"a:j", "x"}},
+   "[a]\nj = x\nk = 1\n",
+   "[a]\nj = x          \nk = 1\n"},
+  {"deleted key",
+   "[a]\nk = 1\ndel = gone ; bye\nz = 1\n",
+   {{"a:del", NULL}},
+   "[a]\nk = 1\nz = 1\n",
+   "[a]\nk = 1\n                \nz = 1\n"},
+  {"deleted joined lines",
+   "[a]\nj = one \\\n  two\nk = 1\n",
+   {{"a:j", NULL}, {"a:k", "2"}},
+   "[a]\nk = 2\n",
+   "[a]\n               \nk = 2\n"},
+  {"deleted, set and added keys",
+   "# top\n[a]\nk = 1 ; one\ndel = 2\n\n[b]\nx = 'q'\n",
+   {{"a:del", NULL}, {"a:k", "9"}, {"b:y", "new"}},
+   "# top\n[a]\nk = 9 ; one\n\n[b]\nx = 'q'\ny = new\n",
+   "# top\n[a]\nk = 9 ; one\n       \n\n[b]\nx = 'q'\ny = new\n"},
+};
+
+static int
+write_file (const char *path, const char *text)
+{
+  FILE *f = fopen (path, "w");
+
+  if (!f)
+    return -1;
+  fputs (text, f);
+  return fclose (f);
+}
+
+static char *
+read_file (const char *path)
+{
+  static char buf[4096];
+  FILE *f = fopen (path, "r");
+  size_t n;
+
+  if (!f)
+    return NULL;
+  n = fread (buf, 1, sizeof buf - 1, f);
+  buf[n] = '\0';
+  fclose (f);
+  return buf;
+}
+
+/* Checks that d holds the changes of c */
+static int
+changed (const dictionary *d, const struct doc_case *c)
+{
+  static const char missing[] = "";
+  const struct doc_op *op;
+  const char *val;
+
+  if (!d)
+    return 0;
+  for (op = c->ops; op < c->ops + 3 && op->key; op++) {
+    val = iniparser_getstring (d, op->key, missing);
+    if (op->val ? val == missing || strcmp (val, op->val) : val != missing)
+      return 0;
+  }
+  return 1;
+}
+
+static int
+run (const char *path, const struct doc_case *c, int flags)
+{
+  iniparser_doc_t *doc;
+  dictionary *d;
+  const struct doc_op *op;
+  const char *how = flags & INIPARSER_SAVE_INPLACE ? "in place" : "rewrite";
+  const char *expect = flags & INIPARSER_SAVE_INPLACE && c->inplace
+      ? c->inplace : c->expect;
+  const char *text;
+  int ok;
+
+  if (write_file (path, c->text) || !(doc = iniparser_doc_load (path))) {
+    printf ("%s (%s): cannot load\n", c->name, how);
+    return 1;
+  }
+  for (op = c->ops; op < c->ops + 3 && op->key; op++) {
+    if (op->val)
+      iniparser_doc_set (doc, op->key, op->val);
+    else
+      iniparser_doc_unset (doc, op->key);
+  }
+  ok = iniparser_doc_save (doc, flags) == 0;
+  iniparser_doc_free (doc);
+  if (!ok) {
+    printf ("%s (%s): cannot save\n", c->name, how);
+    return 1;
+  }
+
+  text = read_file (path);
+  if (!text || strcmp (text, expect)) {
+    printf ("%s (%s): saved \"%s\"\n", c->name, how, text ? text : "");
+    return 1;
+  }
+  d = iniparser_load (path);
+  ok = changed (d, c);
+  iniparser_freedict (d);
+  if (!ok) {
+    printf ("%s (%s): values not read back\n", c->name, how);
+    return 1;
+  }
+
+  /* Nothing changed since: saving again must not touch a byte */
+  doc = iniparser_doc_load (path);
+  ok = doc && changed (iniparser_doc_dict (doc), c)
+      && iniparser_doc_save (doc, flags) == 0;
+  iniparser_doc_free (doc);
+  text = read_file (path);
+  if (!ok || !text || strcmp (text, expect)) {
+    printf ("%s (%s): saved again \"%s\"\n", c->name, how,
+            text ? text : "");
+    return 1;
+  }
+  return 0;
+}
+
+int
+main (void)
+{
+  char path[] = "/tmp/doc-test-XXXXXX";
+  int fd = mkstemp (path);
+  size_t i;
+  int failed = 0;
+
+  if (fd < 0) {
+    perror ("mkstemp");
+    return 1;
+  }
+  close (fd);
+  for (i = 0; i < sizeof cases / sizeof cases[0]; i++) {
+    failed += run (path, &cases[i], 0);
+    failed += run (path, &cases[i], INIPARSER_SAVE_INPLACE);
+  }
+  unlink (path);
+  return failed;
+}
@@ -0,0 +1,182 @@
+// Build command: gcc -O2 hash-bench.c dictionary.c -o hash-bench -lm
+
+/* Compares the dictionary hash functions on section:key strings shaped
+ * like the keys of real configuration files: hashing throughput, hash
+ * collisions, index bucket collisions, and dictionary set/get speed. */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dictionary.h"
+
+#define DEFAULT_KEYS 200000
+
+/* Keeps the compiler from dropping the timed loops */
+static volatile unsigned sink;
+
+typedef struct _HashFunc {
+  const char *name;
+  dictionary_hash_fn fn;
+} HashFunc;
+
+static const HashFunc hashes[] = {
+  { "one-at-a-time", dictionary_hash_oat },
+  { "wide (default)", dictionary_hash },
+};
+
+static const char *sections[] = {
+  "subtitles", "playback", "video", "audio", "network",
+  "playback.video.decoder", "playback.audio.renderer",
+  "plugins.gst-plugins-base.subparse", "ui.main-window.layout",
+  "codecs.h264.hardware-acceleration", "streaming.http.proxy-settings",
+};
+
+static const char *names[] = {
+  "silent", "offset", "font-description", "encoding", "enabled",
+  "max-buffer-size", "preferred-language", "connection-timeout-ms",
+  "color-balance-saturation", "deinterlace-method", "volume",
+  "use-native-video-sink-when-available", "retry-count",
+};
+
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long rng = 88172645463325252ULL;
+
+static unsigned
+rnd (void)
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return (unsigned) rng;
+}
+
+/* Builds n distinct keys such as "playback.video.decoder:max-buffer-size-42" */
+static char **
+make_keys (size_t n, size_t *total_len)
+{
+  char **keys = malloc (n * sizeof *keys);
+  char buf[256];
+  size_t i;
+
+  *total_len = 0;
+  for (i = 0; i < n; i++) {
+    const char *s = sections[rnd () % (sizeof sections / sizeof *sections)];
+    const char *k = names[rnd () % (sizeof names / sizeof *names)];
+
+    if (i % 3 == 0)
+      snprintf (buf, sizeof buf, "%s:%s-%zu", s, k, i);
+    else
+      snprintf (buf, sizeof buf, "%s%zu:%s-%zu", s, i % 97, k, i / 97);
+    keys[i] = strdup (buf);
+    *total_len += strlen (buf);
+  }
+  return keys;
+}
+
+static int
+cmp_unsigned (const void *a, const void *b)
+{
+  unsigned x = *(const unsigned *) a, y = *(const unsigned *) b;
+
+  return x < y ? -1 : x > y;
+}
+
+/* Counts the values equal to a previous one in a sorted copy of v */
+static size_t
+count_duplicates (const unsigned *v, size_t n, unsigned mask)
+{
+  unsigned *s = malloc (n * sizeof *s);
+  size_t i, dup = 0;
+
+  for (i = 0; i < n; i++)
+    s[i] = v[i] & mask;
+  qsort (s, n, sizeof *s, cmp_unsigned);
+  for (i = 1; i < n; i++)
+    dup += s[i] == s[i - 1];
+  free (s);
+  return dup;
+}
+
+static void
+bench (const HashFunc *h, char **keys, size_t n, size_t total_len)
+{
+  unsigned *v = malloc (n * sizeof *v);
+  unsigned mask, sum = 0;
+  dictionary *d;
+  double t0, t_hash, t_set, t_get;
+  size_t i, r, rounds = 20;
+
+  t0 = now ();
+  for (r = 0; r < rounds; r++)
+    for (i = 0; i < n; i++)
+      sum += h->fn (keys[i]);
+  t_hash = (now () - t0) / rounds;
+
+  for (i = 0; i < n; i++)
+    v[i] = h->fn (keys[i]);
+  /* Home buckets in an index at the dictionary's minimum load */
+  for (mask = 1; mask < 2 * n; mask *= 2)
+    ;
+  mask--;
+
+  d = dictionary_new_hash (0, 0, h->fn);
+  t0 = now ();
+  for (i = 0; i < n; i++)
+    dictionary_set (d, keys[i], keys[i]);
+  t_set = now () - t0;
+  t0 = now ();
+  for (r = 0; r < rounds / 4; r++)
+    for (i = 0; i < n; i++)
+      sum += dictionary_get (d, keys[i], NULL) != keys[i];
+  t_get = (now () - t0) / (rounds / 4);
+  dictionary_del (d);
+  sink = sum;
+
+  printf ("%-16s %8.1f %8.2f %10zu %10zu %8.1f %8.1f\n", h->name,
+      t_hash * 1e9 / n, total_len / t_hash / 1e9,
+      count_duplicates (v, n, ~0u), count_duplicates (v, n, mask),
+      t_set * 1e9 / n, t_get * 1e9 / n);
+  free (v);
+}
+
+int
+main (int argc, char *argv[])
+{
+  size_t n = argc > 1 ? strtoul (argv[1], NULL, 10) : DEFAULT_KEYS;
+  size_t total_len, i;
+  double m;
+  char **keys;
+
+  if (n < 2) {
+    printf ("usage: %s [number of keys]\n", argv[0]);
+    return 1;
+  }
+  keys = make_keys (n, &total_len);
+
+  for (m = 1; m < 2 * n; m *= 2)
+    ;
+  printf ("%zu keys, %.1f bytes on average\n", n, (double) total_len / n);
+  printf ("expected for a random hash: %.1f hash collisions, "
+      "%.0f bucket collisions\n\n",
+      (double) n * (n - 1) / 2 / 4294967296.0, n - m * (1 - exp (-(double) n / m)));
+  printf ("%-16s %8s %8s %10s %10s %8s %8s\n", "hash", "ns/key", "GB/s",
+      "collisions", "buckets", "set ns", "get ns");
+  for (i = 0; i < sizeof hashes / sizeof *hashes; i++)
+    bench (&hashes[i], keys, n, total_len);
+
+  for (i = 0; i < n; i++)
+    free (keys[i]);
+  free (keys);
+  return 0;
+}
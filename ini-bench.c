@@ -0,0 +1,323 @@
+// Build command: gcc -O2 ini-bench.c dictionary.c iniparser.c -o ini-bench -lpthread
+
+/* Microbenchmarks for dictionary.c and iniparser.c: dictionary_set, get
+ * (hit, miss and mixed) and unset from 10^2 keys up, iniparser_load,
+ * iniparser_load_mmap, iniparser_load_parallel (with as many threads
+ * as online CPUs) and iniparser_load_compiled (from an up to date cache)
+ * on generated files from 1 KB up, and iniparser_dump_ini on the loaded
+ * dictionaries.
+ *
+ * Results go to stdout as CSV, one line per case:
+ *
+ *   bench,case,n,bytes,ns_per_op,mb_per_s,allocs_per_op,peak_rss_kb
+ *
+ * n is the number of keys, bytes the size of the generated ini file (0
+ * for dictionary cases), which mb_per_s is relative to for both loading
+ * and dumping. An op is one key. allocs_per_op counts malloc, calloc and
+ * realloc calls; it is -1 where they cannot be counted (non-glibc).
+ * peak_rss_kb is the peak resident size of the process so far.
+ *
+ * usage: ini-bench [max keys [max file MB]], default 1000000 keys and
+ * 10 MB, up to 10000000 keys and 100 MB for full runs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "iniparser.h"
+
+#define DEFAULT_MAX_KEYS 1000000
+#define DEFAULT_MAX_MB 10
+
+/* Keeps the compiler from dropping the timed loops */
+static volatile size_t sink;
+
+#ifdef __GLIBC__
+/* Counts allocations by interposing the glibc allocator, atomically as
+ * iniparser_load_parallel allocates from several threads */
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n, size_t size);
+extern void *__libc_realloc (void *p, size_t size);
+
+static size_t allocs;
+
+void *
+malloc (size_t size)
+{
+  __sync_fetch_and_add (&allocs, 1);
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n, size_t size)
+{
+  __sync_fetch_and_add (&allocs, 1);
+  return __libc_calloc (n, size);
+}
+
+void *
+realloc (void *p, size_t size)
+{
+  __sync_fetch_and_add (&allocs, 1);
+  return __libc_realloc (p, size);
+}
+#define ALLOCS() ((long) allocs)
+#else
+#define ALLOCS() (-1L)
+#endif
+
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static long
+peak_rss_kb (void)
+{
+  struct rusage ru;
+
+  if (getrusage (RUSAGE_SELF, &ru) != 0)
+    return -1;
+  return ru.ru_maxrss;
+}
+
+static unsigned long long rng = 88172645463325252ULL;
+
+static unsigned
+rnd (void)
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return (unsigned) rng;
+}
+
+/* Prints one case which took t seconds to run rounds times over n keys */
+static void
+report (const char *bench, const char *name, size_t n, size_t bytes,
+    size_t rounds, double t, long a0)
+{
+  long a1 = ALLOCS ();
+  double ops = (double) n * rounds;
+
+  printf ("%s,%s,%zu,%zu,%.1f,%.1f,%.2f,%ld\n", bench, name, n, bytes,
+      t * 1e9 / ops, (double) bytes * rounds / t / 1e6,
+      a0 < 0 ? -1.0 : (a1 - a0) / ops, peak_rss_kb ());
+  fflush (stdout);
+}
+
+/* Builds n distinct "section:key" strings; prefix tells hits from misses */
+static char **
+make_keys (size_t n, char prefix)
+{
+  char **keys = malloc (n * sizeof *keys);
+  char buf[64];
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    snprintf (buf, sizeof buf, "%csection%u:key-%zu", prefix,
+        rnd () % 1000, i);
+    keys[i] = strdup (buf);
+  }
+  return keys;
+}
+
+static void
+free_keys (char **keys, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    free (keys[i]);
+  free (keys);
+}
+
+static void
+bench_dictionary (size_t n)
+{
+  char **hit = make_keys (n, 'h');
+  char **miss = make_keys (n, 'm');
+  dictionary *d;
+  size_t i, sum = 0;
+  double t0;
+  long a0;
+
+  d = dictionary_new (0);
+  a0 = ALLOCS ();
+  t0 = now ();
+  for (i = 0; i < n; i++)
+    dictionary_set (d, hit[i], "value");
+  report ("dictionary", "set", n, 0, 1, now () - t0, a0);
+
+  a0 = ALLOCS ();
+  t0 = now ();
+  for (i = 0; i < n; i++)
+    sum += dictionary_get (d, hit[i], NULL) != NULL;
+  report ("dictionary", "get-hit", n, 0, 1, now () - t0, a0);
+
+  a0 = ALLOCS ();
+  t0 = now ();
+  for (i = 0; i < n; i++)
+    sum += dictionary_get (d, miss[i], NULL) != NULL;
+  report ("dictionary", "get-miss", n, 0, 1, now () - t0, a0);
+
+  a0 = ALLOCS ();
+  t0 = now ();
+  for (i = 0; i < n; i++)
+    sum += dictionary_get (d, (i & 1) ? miss[i] : hit[i], NULL) != NULL;
+  report ("dictionary", "get-mixed", n, 0, 1, now () - t0, a0);
+
+  a0 = ALLOCS ();
+  t0 = now ();
+  for (i = 0; i < n; i++)
+    dictionary_unset (d, hit[i]);
+  report ("dictionary", "unset", n, 0, 1, now () - t0, a0);
+
+  dictionary_del (d);
+  sink = sum;
+  free_keys (hit, n);
+  free_keys (miss, n);
+}
+
+/* Writes an ini file of about size bytes, returns its number of keys */
+static size_t
+make_ini (const char *path, size_t size)
+{
+  FILE *f = fopen (path, "w");
+  size_t written = 0, nkeys = 0, sec = 0;
+  int len;
+
+  if (!f)
+    return 0;
+  while (written < size) {
+    if (nkeys % 20 == 0) {
+      len = fprintf (f, "\n[section%zu]\n", sec++);
+      written += len;
+      nkeys++;
+    }
+    switch (rnd () % 4) {
+      case 0:
+        len = fprintf (f, "key%zu = %u\n", nkeys, rnd ());
+        break;
+      case 1:
+        len = fprintf (f, "key%zu = \"quoted value %u\" ; comment\n",
+            nkeys, rnd ());
+        break;
+      case 2:
+        len = fprintf (f, "; comment line %u\nkey%zu = yes\n", rnd (),
+            nkeys);
+        break;
+      default:
+        len = fprintf (f, "key%zu = some/longer/path/value/%u.txt\n",
+            nkeys, rnd ());
+        break;
+    }
+    written += len;
+    nkeys++;
+  }
+  fclose (f);
+  return nkeys;
+}
+
+static void
+bench_iniparser (size_t size)
+{
+  char path[] = "/tmp/ini-bench-XXXXXX";
+  char cache[sizeof path + 6];
+  dictionary *d = NULL;
+  iniparser_compiled_t *c;
+  size_t nkeys, r, rounds;
+  FILE *out;
+  double t0;
+  long a0;
+  long threads = sysconf (_SC_NPROCESSORS_ONLN);
+  int fd;
+
+  if (threads < 1)
+    threads = 1;
+  fd = mkstemp (path);
+  if (fd < 0)
+    return;
+  close (fd);
+  nkeys = make_ini (path, size);
+  /* Repeat small cases so that each one runs for a while */
+  rounds = size < (1 << 20) ? (4 << 20) / size : 1;
+
+  a0 = ALLOCS ();
+  t0 = now ();
+  for (r = 0; r < rounds; r++) {
+    if (d)
+      iniparser_freedict (d);
+    d = iniparser_load (path);
+  }
+  report ("iniparser", "load", nkeys, size, rounds, now () - t0, a0);
+
+  a0 = ALLOCS ();
+  t0 = now ();
+  for (r = 0; r < rounds; r++) {
+    iniparser_freedict (d);
+    d = iniparser_load_mmap (path);
+  }
+  report ("iniparser", "load_mmap", nkeys, size, rounds, now () - t0, a0);
+
+  a0 = ALLOCS ();
+  t0 = now ();
+  for (r = 0; r < rounds; r++) {
+    iniparser_freedict (d);
+    d = iniparser_load_parallel (path, threads);
+  }
+  report ("iniparser", "load_parallel", nkeys, size, rounds, now () - t0, a0);
+
+  /* Compile the file once, then time loads from the cache */
+  snprintf (cache, sizeof cache, "%s.cache", path);
+  iniparser_compiled_free (iniparser_load_compiled (path, cache));
+  a0 = ALLOCS ();
+  t0 = now ();
+  for (r = 0; r < rounds; r++) {
+    c = iniparser_load_compiled (path, cache);
+    sink += iniparser_compiled_getint (c, "section0:key1", 0);
+    iniparser_compiled_free (c);
+  }
+  report ("iniparser", "load_compiled", nkeys, size, rounds, now () - t0, a0);
+  unlink (cache);
+
+  out = fopen ("/dev/null", "w");
+  if (d && out) {
+    a0 = ALLOCS ();
+    t0 = now ();
+    for (r = 0; r < rounds; r++)
+      iniparser_dump_ini (d, out);
+    fflush (out);
+    report ("iniparser", "dump_ini", nkeys, size, rounds, now () - t0, a0);
+  }
+  if (out)
+    fclose (out);
+  iniparser_freedict (d);
+  unlink (path);
+}
+
+int
+main (int argc, char *argv[])
+{
+  size_t max_keys = argc > 1 ? strtoul (argv[1], NULL, 10) : DEFAULT_MAX_KEYS;
+  size_t max_mb = argc > 2 ? strtoul (argv[2], NULL, 10) : DEFAULT_MAX_MB;
+  size_t n, size;
+
+  if (max_keys < 100) {
+    printf ("usage: %s [max keys [max file MB]]\n", argv[0]);
+    return 1;
+  }
+  printf ("bench,case,n,bytes,ns_per_op,mb_per_s,allocs_per_op,peak_rss_kb\n");
+  for (n = 100; n <= max_keys; n *= 10)
+    bench_dictionary (n);
+  for (size = 1024; size <= max_mb << 20; size *= 10)
+    bench_iniparser (size);
+  return 0;
+}
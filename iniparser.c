@@ -8,16 +8,71 @@
 /*--------------------------------------------------------------------------*/
 /*---------------------------- Includes ------------------------------------*/
 #include <ctype.h>
+#include <errno.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <pthread.h>
 #include "iniparser.h"
 
+/*
+ * Line scanners, picked at run time among those built for the target.
+ * Compile with -DINIPARSER_SCALAR to only build the portable one.
+ */
+#if defined(INIPARSER_SCALAR)
+#elif defined(__x86_64__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#include <immintrin.h>
+#define INI_SCAN_AVX2
+#endif
+#define INI_SCAN_SSE2
+#elif defined(__aarch64__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define INI_SCAN_NEON
+#endif
+
 /*---------------------------- Defines -------------------------------------*/
 #define ASCIILINESZ         (1024)
+/* Average number of file bytes per entry, used to pre-size dictionaries */
+#define INI_BYTES_PER_ENTRY (32)
+/* Smallest chunk of a file worth a thread of iniparser_load_parallel() */
+#define INI_CHUNK_MIN       (1 << 20)
+/* Most threads used by iniparser_load_parallel() */
+#define INI_THREADS_MAX     (64)
 #define INI_INVALID_KEY     ((char*)-1)
+/* iniparser_replace() flag: fail without reporting errors */
+#define INI_REPLACE_QUIET   (0x100)
+/* Most symbolic links followed to find the file to replace */
+#define INI_LINKS_MAX       (40)
+
+/* Tag, version and byte order mark of compiled ini files */
+#define INI_CACHE_MAGIC     "INICACHE"
+#define INI_CACHE_VERSION   (1)
+#define INI_CACHE_ORDER     (0x01020304u)
+
+/* Bytes of 8 bytes words, for the scalar scanner */
+#define INI_BYTES_LO        0x0101010101010101ULL
+#define INI_BYTES_7F        0x7F7F7F7F7F7F7F7FULL
 
 /*---------------------------------------------------------------------------
                         Private to this module
  ---------------------------------------------------------------------------*/
+/**
+ * Section handle: hash function of the dictionary and lowercase
+ * "section:" prefix of its keys.
+ */
+struct _iniparser_section_ {
+    dictionary_hash_fn  fn ;
+    size_t              len ;      /** Length of prefix */
+    char                prefix[1] ;
+} ;
+
 /**
  * This enum stores the status for each parsed line (internal use only).
  */
@@ -30,6 +85,232 @@ typedef enum _line_status_ {
     LINE_VALUE
 } line_status ;
 
+/**
+ * Part of a line parsed in place: len bytes from p, not NUL-terminated.
+ */
+typedef struct _ini_span_ {
+    char    *   p ;
+    size_t      len ;
+} ini_span ;
+
+/**
+ * Delimiters of a line found by the scanner. eq is the first '=' of the
+ * line and cm the first ';' or '#' after it, NULL if there are none.
+ */
+typedef struct _ini_marks_ {
+    const char  *   eq ;
+    const char  *   cm ;
+} ini_marks ;
+
+/**
+ * Entry recorded while parsing a chunk, to be stored in the dictionary
+ * later: a key and its value, a section (val NULL), or a syntax error
+ * (key (size_t)-1, val the line and len its length).
+ */
+typedef struct _ini_entry_ {
+    size_t          key ;    /** Offset of the key in the chunk keys */
+    const char  *   val ;
+    size_t          len ;
+    unsigned        hash ;   /** Hash of the key */
+    int             lineno ; /** Line number in the chunk */
+} ini_entry ;
+
+/**
+ * Part of ini contents parsed in one go. Lines are either stored in dict
+ * as they are parsed, or recorded as entries when dict is NULL.
+ */
+typedef struct _ini_chunk_ {
+    char        *   buf ;     /** Contents, parsed in place */
+    size_t          len ;     /** Size of the contents */
+    const char  *   name ;    /** Name of the contents in error messages */
+    int             line0 ;   /** Number of lines before the chunk */
+    dictionary  *   dict ;    /** Dictionary to fill in, or NULL */
+    dictionary_hash_fn  fn ;  /** Hash function of recorded keys */
+    char        *   tmp ;     /** Current section, then "section:key" */
+    size_t          tmpsize ;
+    char        *   keys ;    /** Recorded keys, one after the other */
+    size_t          klen ;
+    size_t          ksize ;
+    ini_entry   *   ent ;     /** Recorded entries */
+    size_t          n ;
+    size_t          nsize ;
+    int             lines ;   /** Number of lines parsed */
+    int             errs ;    /** Number of syntax errors */
+    int             mem_err ; /** Non-zero if memory ran out */
+    iniparser_doc_t * doc ;   /** Document to map lines in, or NULL */
+    size_t          loff ;    /** Start of the line being stored */
+    size_t          lend ;    /** End of the line, past its newline */
+    size_t          leq ;     /** Its '=', (size_t)-1 if lines were joined */
+} ini_chunk ;
+
+/**
+ * Key or section line of a document, by its offsets in the text. The
+ * value of a key line may be rewritten in place up to vmax, which is
+ * where its comment or the line ends.
+ */
+typedef struct _ini_line_ {
+    size_t          key ;     /** Offset of the key in the document keys */
+    size_t          name ;    /** Offset of the name past "section:" in the key */
+    unsigned        hash ;    /** Hash of the key */
+    int             sec ;     /** Non-zero for a section line */
+    int             dead ;    /** Non-zero once deleted */
+    size_t          off ;     /** Start of the line */
+    size_t          end ;     /** End of the line, past its newline */
+    size_t          voff ;    /** Start of the value, (size_t)-1 if joined */
+    size_t          vend ;    /** End of the value, quotes included */
+    size_t          vmax ;    /** End of the room for the value */
+    size_t          last ;    /** Sections: end of their last line */
+    ssize_t         prev ;    /** Previous line of the same key, or -1 */
+    unsigned        gen ;     /** Last save which visited the line */
+} ini_line ;
+
+/**
+ * Change to the text of a document: bytes [off, end) replaced with len
+ * bytes of the edit text at txt. Inserted lines also keep their key.
+ */
+typedef enum _ini_edit_kind_ {
+    INI_EDIT_VALUE,     /** New value of a key line */
+    INI_EDIT_LINE,      /** New contents of a key line, joined before */
+    INI_EDIT_DELETE,    /** Removal of a key line */
+    INI_EDIT_INSERT     /** New key or section line */
+} ini_edit_kind ;
+
+typedef struct _ini_edit_ {
+    ini_edit_kind   kind ;
+    size_t          off ;
+    size_t          end ;
+    size_t          txt ;
+    size_t          len ;
+    ssize_t         line ;    /** Line changed, or -1 */
+    size_t          seq ;     /** Order of creation, to sort stably */
+    size_t          key ;     /** Inserted: key in the edit text */
+    size_t          lead ;    /** Inserted: bytes before the line itself */
+    size_t          eq ;      /** Inserted or joined: '=' from the line start */
+} ini_edit ;
+
+/**
+ * Key of a document entry new to its file, waiting to be inserted
+ */
+typedef struct _ini_new_ {
+    const char  *   key ;
+    size_t          slen ;    /** Length of its section name */
+    size_t          seq ;     /** Order of first change */
+    size_t          gseq ;    /** Order of first change in its section */
+} ini_new ;
+
+/**
+ * Changes to a document being gathered by iniparser_doc_save()
+ */
+typedef struct _ini_save_ {
+    iniparser_doc_t * doc ;
+    ini_edit    *   ed ;      /** Edits */
+    size_t          ne ;
+    size_t          nesize ;
+    char        *   et ;      /** Edit text */
+    size_t          etlen ;
+    size_t          etsize ;
+    ini_new     *   nw ;      /** Keys to insert */
+    size_t          nn ;
+    size_t          nnsize ;
+    int             nl ;      /** Non-zero once a missing last newline is added */
+    int             err ;     /** Non-zero if memory ran out */
+} ini_save ;
+
+/**
+ * Document: a dictionary, the text it was loaded from, and where each
+ * key and section is in that text.
+ */
+struct _iniparser_doc_ {
+    dictionary  *   dict ;
+    char        *   name ;    /** File name */
+    struct stat     st ;      /** File status when last read or written */
+    char        *   text ;    /** Contents of the file */
+    size_t          len ;
+    size_t          size ;
+    char        *   keys ;    /** Keys of the lines, one after the other */
+    size_t          klen ;
+    size_t          ksize ;
+    ini_line    *   lines ;   /** Key and section lines, in file order */
+    size_t          n ;
+    size_t          nsize ;
+    ssize_t     *   table ;   /** Hash table of the last line of each key */
+    size_t          tsize ;
+    ssize_t         cur ;     /** Section line of the lines being mapped */
+    size_t          top ;     /** End of the last line before any section */
+    char        *   dirty ;   /** Keys changed since the last save */
+    size_t          dlen ;
+    size_t          dsize ;
+    int             all ;     /** Non-zero if dirty lost keys: check all */
+    unsigned        gen ;     /** Number of saves */
+    int             stale ;   /** Non-zero if lines need mapping again */
+} ;
+
+/**
+ * Growable output buffer of the dumpers. With a file, it is written out
+ * when it cannot grow; without one, err is set instead.
+ */
+typedef struct _ini_out_ {
+    char        *   buf ;
+    size_t          len ;
+    size_t          size ;
+    FILE        *   f ;       /** File to write to, or NULL */
+    int             err ;     /** Non-zero if memory ran out */
+} ini_out ;
+
+/**
+ * Header of a compiled ini file. It is followed by the name of the
+ * source file, padded with NULs to a multiple of 8 bytes, then by a
+ * frozen dictionary of the contents of the source. All fields but the
+ * last come from the source file, and tell whether the header matches it.
+ */
+typedef struct _ini_cache_head_ {
+    char            magic[8] ;  /** INI_CACHE_MAGIC, not NUL-terminated */
+    uint32_t        version ;   /** INI_CACHE_VERSION */
+    uint32_t        order ;     /** INI_CACHE_ORDER */
+    uint64_t        dev ;       /** Device of the source */
+    uint64_t        ino ;       /** Inode of the source */
+    uint64_t        size ;      /** Size of the source */
+    int64_t         mtime ;     /** Modification time of the source, in ns */
+    uint32_t        namelen ;   /** Size of the padded name */
+    uint32_t        block ;     /** Size of the frozen dictionary */
+} ini_cache_head ;
+
+/**
+ * Compiled ini file: a frozen dictionary inside the mapping of its
+ * cache file, or inside an allocated copy of one.
+ */
+struct _iniparser_compiled_ {
+    const dictionary_frozen *   f ;
+    void                    *   base ;    /** Mapping or copy */
+    size_t                      len ;     /** Size of base */
+    int                         mapped ;  /** Non-zero if base is mapped */
+} ;
+
+/**
+ * Scanner: finds the end of the line starting at p, i.e. the first '\n'
+ * before end or end itself, filling in the marks of the line on the way.
+ */
+typedef const char * (*ini_scan_fn)(const char * p, const char * end, ini_marks * m);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Hash the first bytes of a string
+  @param    s   String to hash
+  @param    n   Number of bytes to hash
+  @return   FNV-1a hash of the bytes
+ */
+/*--------------------------------------------------------------------------*/
+static unsigned ini_hash_bytes(const char * s, size_t n)
+{
+    unsigned    h = 2166136261u ;
+
+    while (n--) {
+        h ^= (unsigned char)*s++ ;
+        h *= 16777619u ;
+    }
+    return h ;
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Convert a string to lowercase.
@@ -58,54 +339,22 @@ static const char * strlwc(const char * in, char *out, unsigned len)
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief    Duplicate a string
-  @param    s String to duplicate
-  @return   Pointer to a newly allocated string, to be freed with free()
-
-  This is a replacement for strdup(). This implementation is provided
-  for systems that do not have it.
- */
-/*--------------------------------------------------------------------------*/
-static char * xstrdup(const char * s)
-{
-    char * t ;
-    size_t len ;
-    if (!s)
-        return NULL ;
-
-    len = strlen(s) + 1 ;
-    t = (char*) malloc(len) ;
-    if (t) {
-        memcpy(t, s, len) ;
-    }
-    return t ;
-}
+  @brief    Get the form of a key to look up in a dictionary.
+  @param    d   Dictionary to search.
+  @param    key Key as given by the caller.
+  @param    out Output buffer.
+  @param    len Size of the out buffer.
+  @return   key itself, or its lowercase copy in out.
 
-/*-------------------------------------------------------------------------*/
-/**
-  @brief    Remove blanks at the beginning and the end of a string.
-  @param    str  String to parse and alter.
-  @return   unsigned New size of the string.
+  Dictionaries created with DICTIONARY_NOCASE ignore case by themselves,
+  so keys are only copied to lower case for other dictionaries.
  */
 /*--------------------------------------------------------------------------*/
-static unsigned strstrip(char * s)
+static const char * iniparser_key(const dictionary * d, const char * key, char * out, unsigned len)
 {
-    char *last = NULL ;
-    char *dest = s;
-
-    if (s==NULL) return 0;
-
-    last = s + strlen(s);
-    while (isspace((int)*s) && *s) s++;
-    while (last > s) {
-        if (!isspace((int)*(last-1)))
-            break ;
-        last -- ;
-    }
-    *last = (char)0;
-
-    memmove(dest,s,last - s + 1);
-    return last - s;
+    if (dictionary_flags(d) & DICTIONARY_NOCASE)
+        return key ;
+    return strlwc(key, out, len);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -125,6 +374,17 @@ static int default_error_callback(const char *format, ...)
 
 static int (*iniparser_error_callback)(const char*, ...) = default_error_callback;
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Error callback of operations which fail silently
+ */
+/*--------------------------------------------------------------------------*/
+static int quiet_error_callback(const char *format, ...)
+{
+  (void)format;
+  return 0;
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Configure a function to receive the error messages.
@@ -167,8 +427,11 @@ int iniparser_getnsec(const dictionary * d)
     int nsec ;
 
     if (d==NULL) return -1 ;
+    nsec = dictionary_nsections(d);
+    if (nsec>=0)
+        return nsec ;
     nsec=0 ;
-    for (i=0 ; i<d->size ; i++) {
+    for (i=0 ; i<d->used ; i++) {
         if (d->key[i]==NULL)
             continue ;
         if (strchr(d->key[i], ':')==NULL) {
@@ -196,10 +459,17 @@ const char * iniparser_getsecname(const dictionary * d, int n)
 {
     int i ;
     int foundsec ;
+    ssize_t sec ;
 
     if (d==NULL || n<0) return NULL ;
+    if (dictionary_nsections(d)>=0) {
+        /* Walk the sections only */
+        for (sec=dictionary_section_next(d, -1) ; sec>=0 && n>0 ; n--)
+            sec = dictionary_section_next(d, sec);
+        return sec>=0 ? d->key[sec] : NULL ;
+    }
     foundsec=0 ;
-    for (i=0 ; i<d->size ; i++) {
+    for (i=0 ; i<d->used ; i++) {
         if (d->key[i]==NULL)
             continue ;
         if (strchr(d->key[i], ':')==NULL) {
@@ -232,7 +502,7 @@ void iniparser_dump(const dictionary * d, FILE * f)
     int     i ;
 
     if (d==NULL || f==NULL) return ;
-    for (i=0 ; i<d->size ; i++) {
+    for (i=0 ; i<d->used ; i++) {
         if (d->key[i]==NULL)
             continue ;
         if (d->val[i]!=NULL) {
@@ -246,39 +516,325 @@ void iniparser_dump(const dictionary * d, FILE * f)
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief    Save a dictionary to a loadable ini file
+  @brief    Make room in a growable buffer
+  @param    buf     Buffer to grow, updated
+  @param    size    Its size, updated
+  @param    need    Number of bytes needed
+  @return   0 if Ok, -1 if allocation failed, leaving the buffer as is
+ */
+/*--------------------------------------------------------------------------*/
+static int iniparser_reserve(char ** buf, size_t * size, size_t need)
+{
+    size_t  n = *size ? *size : 64 ;
+    char *  t ;
+
+    if (need <= *size)
+        return 0 ;
+    while (n < need)
+        n *= 2 ;
+    t = (char*) realloc(*buf, n);
+    if (!t)
+        return -1 ;
+    *buf  = t ;
+    *size = n ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Append bytes to an output buffer
+  @param    o   Output buffer
+  @param    s   Bytes to append
+  @param    n   Number of bytes
+  @return   void
+
+  If the buffer cannot grow, an output with a file writes out what it
+  holds and carries on with smaller writes, while one without a file
+  is marked in error.
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_out(ini_out * o, const char * s, size_t n)
+{
+    if (o->err || n==0)
+        return ;
+    if (iniparser_reserve(&o->buf, &o->size, o->len + n)!=0) {
+        if (o->f==NULL) {
+            o->err = 1 ;
+            return ;
+        }
+        fwrite(o->buf, 1, o->len, o->f);
+        o->len = 0 ;
+        if (n > o->size) {
+            fwrite(s, 1, n, o->f);
+            return ;
+        }
+    }
+    memcpy(o->buf + o->len, s, n);
+    o->len += n ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Append "key = value" to an output buffer
+  @param    o   Output buffer
+  @param    key Key, without its section
+  @param    val Value, NULL for none
+  @param    pad Width to pad the key to with blanks
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_out_entry(
+    ini_out * o,
+    const char * key,
+    const char * val,
+    size_t pad)
+{
+    static const char   blanks[] = "                                " ;
+    size_t              len = strlen(key) ;
+
+    iniparser_out(o, key, len);
+    if (len < pad)
+        iniparser_out(o, blanks, pad - len);
+    iniparser_out(o, " = ", 3);
+    if (val)
+        iniparser_out(o, val, strlen(val));
+    iniparser_out(o, "\n", 1);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Append a "[section]" line to an output buffer
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_out_section(ini_out * o, const char * s)
+{
+    iniparser_out(o, "\n[", 2);
+    iniparser_out(o, s, strlen(s));
+    iniparser_out(o, "]\n", 2);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Write out an output buffer to its file and free it
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_out_flush(ini_out * o)
+{
+    if (o->f && o->len)
+        fwrite(o->buf, 1, o->len, o->f);
+    free(o->buf);
+    o->buf = NULL ;
+    o->len = o->size = 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Render an indexed dictionary section as ini
+  @param    o   Output buffer
+  @param    d   Dictionary to dump, with a section index
+  @param    sec Slot of the section to dump, nothing is done if negative
+  @param    s   Section name to print
+  @return   void
+
+  Only visits the keys of the section.
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_render_slot(
+    ini_out * o,
+    const dictionary * d,
+    ssize_t sec,
+    const char * s)
+{
+    ssize_t     j ;
+    size_t      seclen ;
+
+    if (sec<0) return ;
+
+    seclen = strlen(d->key[sec]);
+    iniparser_out_section(o, s);
+    for (j=dictionary_section_key_next(d, sec, -1) ; j>=0 ;
+         j=dictionary_section_key_next(d, sec, j))
+        iniparser_out_entry(o, d->key[j]+seclen+1, d->val[j], 30);
+    iniparser_out(o, "\n", 1);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Render a dictionary section as ini, scanning all entries
+  @param    o   Output buffer
   @param    d   Dictionary to dump
-  @param    f   Opened file pointer to dump to
+  @param    s   Section name to dump, as stored in d
+  @param    name Section name to print
   @return   void
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_render_scan(
+    ini_out * o,
+    const dictionary * d,
+    const char * s,
+    const char * name)
+{
+    int     j ;
+    size_t  seclen = strlen(s);
 
-  This function dumps a given dictionary into a loadable ini file.
-  It is Ok to specify @c stderr or @c stdout as output files.
+    iniparser_out_section(o, name);
+    for (j=0 ; j<d->used ; j++) {
+        if (d->key[j]==NULL)
+            continue ;
+        if (!strncmp(d->key[j], s, seclen) && d->key[j][seclen]==':')
+            iniparser_out_entry(o, d->key[j]+seclen+1, d->val[j], 30);
+    }
+    iniparser_out(o, "\n", 1);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Render the sections of an unindexed dictionary as ini
+  @param    o       Output buffer
+  @param    d       Dictionary to dump, without a section index
+  @param    nsec    Number of sections in d
+  @return   0 if Ok, -1 if memory ran out before anything was rendered
+
+  Groups the keys by section in one pass over the entries: sections are
+  numbered in slot order through a small hash table of their names, and
+  keys are counting-sorted by section number, which keeps them in slot
+  order within each section.
  */
 /*--------------------------------------------------------------------------*/
-void iniparser_dump_ini(const dictionary * d, FILE * f)
+static int iniparser_render_grouped(ini_out * o, const dictionary * d, int nsec)
+{
+    size_t      tsize = 4 ;
+    size_t      h ;
+    size_t      n ;
+    int     *   table ;
+    int     *   secs ;
+    int     *   ord ;
+    int     *   start ;
+    int     *   keys ;
+    const char * colon ;
+    int         i ;
+    int         s ;
+
+    while (tsize < (size_t)nsec * 2)
+        tsize *= 2 ;
+    table = (int*) calloc(tsize, sizeof *table);
+    secs  = (int*) malloc((size_t)nsec * sizeof *secs);
+    ord   = (int*) malloc((size_t)d->used * sizeof *ord);
+    start = (int*) calloc((size_t)nsec + 1, sizeof *start);
+    keys  = (int*) malloc((size_t)d->used * sizeof *keys);
+    if (!table || !secs || !ord || !start || !keys) {
+        free(table); free(secs); free(ord); free(start); free(keys);
+        return -1 ;
+    }
+
+    /* Number the sections, table holds their number plus one */
+    s = 0 ;
+    for (i=0 ; i<d->used ; i++) {
+        ord[i] = -1 ;
+        if (d->key[i]==NULL || strchr(d->key[i], ':')!=NULL)
+            continue ;
+        n = strlen(d->key[i]);
+        for (h=ini_hash_bytes(d->key[i], n) & (tsize-1) ; table[h] ;
+             h=(h+1) & (tsize-1))
+            ;
+        table[h] = s + 1 ;
+        secs[s++] = i ;
+    }
+    /* Find the section of each key, count the keys of each section */
+    for (i=0 ; i<d->used ; i++) {
+        if (d->key[i]==NULL || (colon=strchr(d->key[i], ':'))==NULL)
+            continue ;
+        n = (size_t)(colon - d->key[i]);
+        for (h=ini_hash_bytes(d->key[i], n) & (tsize-1) ; table[h] ;
+             h=(h+1) & (tsize-1)) {
+            s = table[h] - 1 ;
+            if (!strncmp(d->key[secs[s]], d->key[i], n) &&
+                d->key[secs[s]][n]=='\0') {
+                ord[i] = s ;
+                start[s+1] ++ ;
+                break ;
+            }
+        }
+    }
+    for (s=0 ; s<nsec ; s++)
+        start[s+1] += start[s] ;
+    /* start[s] runs to the end of section s while placing its keys */
+    for (i=0 ; i<d->used ; i++)
+        if (ord[i]>=0)
+            keys[start[ord[i]]++] = i ;
+
+    for (s=0, i=0 ; s<nsec ; s++) {
+        n = strlen(d->key[secs[s]]);
+        iniparser_out_section(o, d->key[secs[s]]);
+        for ( ; i<start[s] ; i++)
+            iniparser_out_entry(o, d->key[keys[i]]+n+1, d->val[keys[i]], 30);
+        iniparser_out(o, "\n", 1);
+    }
+    free(table); free(secs); free(ord); free(start); free(keys);
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Render a dictionary as a loadable ini file
+  @param    o   Output buffer
+  @param    d   Dictionary to dump
+  @return   void
+
+  Sections and their keys come out in the order of the section index,
+  or in slot order without one, in a single pass over the entries.
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_render(ini_out * o, const dictionary * d)
 {
     int          i ;
     int          nsec ;
-    const char * secname ;
-
-    if (d==NULL || f==NULL) return ;
+    ssize_t      sec ;
 
     nsec = iniparser_getnsec(d);
     if (nsec<1) {
         /* No section in file: dump all keys as they are */
-        for (i=0 ; i<d->size ; i++) {
+        for (i=0 ; i<d->used ; i++) {
             if (d->key[i]==NULL)
                 continue ;
-            fprintf(f, "%s = %s\n", d->key[i], d->val[i]);
+            iniparser_out_entry(o, d->key[i], d->val[i], 0);
         }
         return ;
     }
-    for (i=0 ; i<nsec ; i++) {
-        secname = iniparser_getsecname(d, i) ;
-        iniparser_dumpsection_ini(d, secname, f);
+    if (dictionary_nsections(d)>=0) {
+        for (sec=dictionary_section_next(d, -1) ; sec>=0 ;
+             sec=dictionary_section_next(d, sec))
+            iniparser_render_slot(o, d, sec, d->key[sec]);
+    } else if (iniparser_render_grouped(o, d, nsec)!=0) {
+        /* Out of memory: one scan per section */
+        for (i=0 ; i<d->used ; i++)
+            if (d->key[i] && strchr(d->key[i], ':')==NULL)
+                iniparser_render_scan(o, d, d->key[i], d->key[i]);
     }
-    fprintf(f, "\n");
-    return ;
+    iniparser_out(o, "\n", 1);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Save a dictionary to a loadable ini file
+  @param    d   Dictionary to dump
+  @param    f   Opened file pointer to dump to
+  @return   void
+
+  This function dumps a given dictionary into a loadable ini file.
+  It is Ok to specify @c stderr or @c stdout as output files.
+
+  The file is formatted in memory and written with a single fwrite().
+ */
+/*--------------------------------------------------------------------------*/
+void iniparser_dump_ini(const dictionary * d, FILE * f)
+{
+    ini_out o = { NULL, 0, 0, NULL, 0 } ;
+
+    if (d==NULL || f==NULL) return ;
+    o.f = f ;
+    iniparser_render(&o, d);
+    iniparser_out_flush(&o);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -295,28 +851,18 @@ void iniparser_dump_ini(const dictionary * d, FILE * f)
 /*--------------------------------------------------------------------------*/
 void iniparser_dumpsection_ini(const dictionary * d, const char * s, FILE * f)
 {
-    int     j ;
-    char    keym[ASCIILINESZ+1];
-    int     seclen ;
-
-    if (d==NULL || f==NULL) return ;
-    if (! iniparser_find_entry(d, s)) return ;
+    ini_out         o = { NULL, 0, 0, NULL, 0 } ;
+    char            keym[ASCIILINESZ+1];
+    const char  *   lc_s ;
 
-    seclen  = (int)strlen(s);
-    fprintf(f, "\n[%s]\n", s);
-    sprintf(keym, "%s:", s);
-    for (j=0 ; j<d->size ; j++) {
-        if (d->key[j]==NULL)
-            continue ;
-        if (!strncmp(d->key[j], keym, seclen+1)) {
-            fprintf(f,
-                    "%-30s = %s\n",
-                    d->key[j]+seclen+1,
-                    d->val[j] ? d->val[j] : "");
-        }
-    }
-    fprintf(f, "\n");
-    return ;
+    if (d==NULL || f==NULL || s==NULL) return ;
+    o.f = f ;
+    lc_s = iniparser_key(d, s, keym, sizeof(keym));
+    if (dictionary_nsections(d)>=0)
+        iniparser_render_slot(&o, d, dictionary_section_find(d, lc_s), s);
+    else if (iniparser_find_entry(d, s))
+        iniparser_render_scan(&o, d, lc_s, s);
+    iniparser_out_flush(&o);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -336,13 +882,16 @@ int iniparser_getsecnkeys(const dictionary * d, const char * s)
     nkeys = 0;
 
     if (d==NULL) return nkeys;
+    if (dictionary_nsections(d)>=0)
+        return dictionary_section_nkeys(d, dictionary_section_find(d,
+                                        iniparser_key(d, s, keym, sizeof(keym))));
     if (! iniparser_find_entry(d, s)) return nkeys;
 
     seclen  = (int)strlen(s);
     strlwc(s, keym, sizeof(keym));
     keym[seclen] = ':';
 
-    for (j=0 ; j<d->size ; j++) {
+    for (j=0 ; j<d->used ; j++) {
         if (d->key[j]==NULL)
             continue ;
         if (!strncmp(d->key[j], keym, seclen+1))
@@ -373,8 +922,17 @@ const char ** iniparser_getseckeys(const dictionary * d, const char * s, const c
 {
     int i, j, seclen ;
     char keym[ASCIILINESZ+1];
+    ssize_t sec, k ;
 
     if (d==NULL || keys==NULL) return NULL;
+    if (dictionary_nsections(d)>=0) {
+        sec = dictionary_section_find(d, iniparser_key(d, s, keym, sizeof(keym)));
+        if (sec<0) return NULL;
+        for (i=0, k=dictionary_section_key_next(d, sec, -1) ; k>=0 ;
+             k=dictionary_section_key_next(d, sec, k))
+            keys[i++] = d->key[k];
+        return keys;
+    }
     if (! iniparser_find_entry(d, s)) return NULL;
 
     seclen  = (int)strlen(s);
@@ -383,7 +941,7 @@ const char ** iniparser_getseckeys(const dictionary * d, const char * s, const c
 
     i = 0;
 
-    for (j=0 ; j<d->size ; j++) {
+    for (j=0 ; j<d->used ; j++) {
         if (d->key[j]==NULL)
             continue ;
         if (!strncmp(d->key[j], keym, seclen+1)) {
@@ -419,7 +977,7 @@ const char * iniparser_getstring(const dictionary * d, const char * key, const c
     if (d==NULL || key==NULL)
         return def ;
 
-    lc_key = strlwc(key, tmp_str, sizeof(tmp_str));
+    lc_key = iniparser_key(d, key, tmp_str, sizeof(tmp_str));
     sval = dictionary_get(d, lc_key, def);
     return sval ;
 }
@@ -449,15 +1007,20 @@ const char * iniparser_getstring(const dictionary * d, const char * key, const c
   handling.
 
   Credits: Thanks to A. Becker for suggesting strtol()
+
+  The converted value is cached in the dictionary until the key is set
+  again, so repeated reads of a key do not parse its value again. The
+  cache is filled safely while other threads read the same dictionary,
+  as long as none of them modifies it.
  */
 /*--------------------------------------------------------------------------*/
 long int iniparser_getlongint(const dictionary * d, const char * key, long int notfound)
 {
-    const char * str ;
+    char tmp_str[ASCIILINESZ+1];
 
-    str = iniparser_getstring(d, key, INI_INVALID_KEY);
-    if (str==INI_INVALID_KEY) return notfound ;
-    return strtol(str, NULL, 0);
+    if (d==NULL || key==NULL)
+        return notfound ;
+    return dictionary_getlongint(d, iniparser_key(d, key, tmp_str, sizeof(tmp_str)), notfound);
 }
 
 
@@ -486,6 +1049,9 @@ long int iniparser_getlongint(const dictionary * d, const char * key, long int n
   handling.
 
   Credits: Thanks to A. Becker for suggesting strtol()
+
+  The converted value is cached as by iniparser_getlongint(), which is
+  safe while other threads read the same dictionary.
  */
 /*--------------------------------------------------------------------------*/
 int iniparser_getint(const dictionary * d, const char * key, int notfound)
@@ -504,15 +1070,18 @@ int iniparser_getint(const dictionary * d, const char * key, int notfound)
   This function queries a dictionary for a key. A key as read from an
   ini file is given as "section:key". If the key cannot be found,
   the notfound value is returned.
+
+  The converted value is cached as by iniparser_getlongint(), which is
+  safe while other threads read the same dictionary.
  */
 /*--------------------------------------------------------------------------*/
 double iniparser_getdouble(const dictionary * d, const char * key, double notfound)
 {
-    const char * str ;
+    char tmp_str[ASCIILINESZ+1];
 
-    str = iniparser_getstring(d, key, INI_INVALID_KEY);
-    if (str==INI_INVALID_KEY) return notfound ;
-    return atof(str);
+    if (d==NULL || key==NULL)
+        return notfound ;
+    return dictionary_getdouble(d, iniparser_key(d, key, tmp_str, sizeof(tmp_str)), notfound);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -545,23 +1114,18 @@ double iniparser_getdouble(const dictionary * d, const char * key, double notfou
 
   The notfound value returned if no boolean is identified, does not
   necessarily have to be 0 or 1.
+
+  The converted value is cached as by iniparser_getlongint(), which is
+  safe while other threads read the same dictionary.
  */
 /*--------------------------------------------------------------------------*/
 int iniparser_getboolean(const dictionary * d, const char * key, int notfound)
 {
-    int          ret ;
-    const char * c ;
+    char tmp_str[ASCIILINESZ+1];
 
-    c = iniparser_getstring(d, key, INI_INVALID_KEY);
-    if (c==INI_INVALID_KEY) return notfound ;
-    if (c[0]=='y' || c[0]=='Y' || c[0]=='1' || c[0]=='t' || c[0]=='T') {
-        ret = 1 ;
-    } else if (c[0]=='n' || c[0]=='N' || c[0]=='0' || c[0]=='f' || c[0]=='F') {
-        ret = 0 ;
-    } else {
-        ret = notfound ;
-    }
-    return ret;
+    if (d==NULL || key==NULL)
+        return notfound ;
+    return dictionary_getboolean(d, iniparser_key(d, key, tmp_str, sizeof(tmp_str)), notfound);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -601,7 +1165,7 @@ int iniparser_find_entry(const dictionary * ini, const char * entry)
 int iniparser_set(dictionary * ini, const char * entry, const char * val)
 {
     char tmp_str[ASCIILINESZ+1];
-    return dictionary_set(ini, strlwc(entry, tmp_str, sizeof(tmp_str)), val) ;
+    return dictionary_set(ini, iniparser_key(ini, entry, tmp_str, sizeof(tmp_str)), val) ;
 }
 
 /*-------------------------------------------------------------------------*/
@@ -617,208 +1181,2998 @@ int iniparser_set(dictionary * ini, const char * entry, const char * val)
 void iniparser_unset(dictionary * ini, const char * entry)
 {
     char tmp_str[ASCIILINESZ+1];
-    dictionary_unset(ini, strlwc(entry, tmp_str, sizeof(tmp_str)));
+    dictionary_unset(ini, iniparser_key(ini, entry, tmp_str, sizeof(tmp_str)));
 }
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief    Load a single line from an INI file
-  @param    input_line  Input line, may be concatenated multi-line input
-  @param    section     Output space to store section
-  @param    key         Output space to store key
-  @param    value       Output space to store value
-  @return   line_status value
+  @brief    Get a handle on a section of a dictionary
+  @param    d   Dictionary to search
+  @param    s   Section name
+  @return   Newly allocated section handle, or NULL in case of error
+
+  The handle keeps the lowercase "section:" prefix of the keys of the
+  section and the hash function of d.
  */
 /*--------------------------------------------------------------------------*/
-static line_status iniparser_line(
-    const char * input_line,
-    char * section,
-    char * key,
-    char * value)
+iniparser_section_t * iniparser_section(const dictionary * d, const char * s)
 {
-    line_status sta ;
-    char * line = NULL;
-    size_t      len ;
+    iniparser_section_t *   sec ;
+    size_t                  len ;
 
-    line = xstrdup(input_line);
-    len = strstrip(line);
-
-    sta = LINE_UNPROCESSED ;
-    if (len<1) {
-        /* Empty line */
-        sta = LINE_EMPTY ;
-    } else if (line[0]=='#' || line[0]==';') {
-        /* Comment line */
-        sta = LINE_COMMENT ;
-    } else if (line[0]=='[' && line[len-1]==']') {
-        /* Section name */
-        sscanf(line, "[%[^]]", section);
-        strstrip(section);
-        strlwc(section, section, len);
-        sta = LINE_SECTION ;
-    } else if (sscanf (line, "%[^=] = \"%[^\"]\"", key, value) == 2
-           ||  sscanf (line, "%[^=] = '%[^\']'",   key, value) == 2) {
-        /* Usual key=value with quotes, with or without comments */
-        strstrip(key);
-        strlwc(key, key, len);
-        /* Don't strip spaces from values surrounded with quotes */
-        sta = LINE_VALUE ;
-    } else if (sscanf (line, "%[^=] = %[^;#]", key, value) == 2) {
-        /* Usual key=value without quotes, with or without comments */
-        strstrip(key);
-        strlwc(key, key, len);
-        strstrip(value);
-        /*
-         * sscanf cannot handle '' or "" as empty values
-         * this is done here
-         */
-        if (!strcmp(value, "\"\"") || (!strcmp(value, "''"))) {
-            value[0]=0 ;
-        }
-        sta = LINE_VALUE ;
-    } else if (sscanf(line, "%[^=] = %[;#]", key, value)==2
-           ||  sscanf(line, "%[^=] %[=]", key, value) == 2) {
-        /*
-         * Special cases:
-         * key=
-         * key=;
-         * key=#
-         */
-        strstrip(key);
-        strlwc(key, key, len);
-        value[0]=0 ;
-        sta = LINE_VALUE ;
-    } else {
-        /* Generate syntax error */
-        sta = LINE_ERROR ;
-    }
+    if (d==NULL || s==NULL) return NULL ;
 
-    free(line);
-    return sta ;
+    len = strlen(s);
+    sec = (iniparser_section_t*) malloc(sizeof *sec + len + 2);
+    if (sec==NULL) return NULL ;
+    sec->fn  = dictionary_hashfn(d);
+    sec->len = len + 1 ;
+    strlwc(s, sec->prefix, (unsigned)len + 1);
+    sec->prefix[len]   = ':' ;
+    sec->prefix[len+1] = '\0' ;
+    return sec ;
 }
 
 /*-------------------------------------------------------------------------*/
 /**
-  @brief    Parse an ini file and return an allocated dictionary object
-  @param    ininame Name of the ini file to read.
-  @return   Pointer to newly allocated dictionary
-
-  This is the parser for ini files. This function is called, providing
-  the name of the file to be read. It returns a dictionary object that
-  should not be accessed directly, but through accessor functions
-  instead.
-
-  The returned dictionary must be freed using iniparser_freedict().
+  @brief    Free a section handle
+  @param    sec Section handle to free
+  @return   void
  */
 /*--------------------------------------------------------------------------*/
-dictionary * iniparser_load(const char * ininame)
+void iniparser_section_free(iniparser_section_t * sec)
 {
-    FILE * in ;
-
-    char line    [ASCIILINESZ+1] ;
-    char section [ASCIILINESZ+1] ;
-    char key     [ASCIILINESZ+1] ;
-    char tmp     [(ASCIILINESZ * 2) + 1] ;
-    char val     [ASCIILINESZ+1] ;
+    free(sec);
+}
 
-    int  last=0 ;
-    int  len ;
-    int  lineno=0 ;
-    int  errs=0;
-    int  mem_err=0;
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Build a key handle for a key of a section
+  @param    sec Section handle
+  @param    key Key name within the section
+  @param    k   Key handle to initialize
+  @return   int 0 if Ok, -1 otherwise
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_section_key(const iniparser_section_t * sec, const char * key, iniparser_key_t * k)
+{
+    size_t  len ;
 
-    dictionary * dict ;
+    if (sec==NULL || key==NULL || k==NULL) return -1 ;
 
-    if ((in=fopen(ininame, "r"))==NULL) {
-        iniparser_error_callback("iniparser: cannot open %s\n", ininame);
-        return NULL ;
-    }
+    len = strlen(key);
+    k->buf = (char*) malloc(sec->len + len + 1);
+    if (k->buf==NULL) return -1 ;
+    memcpy(k->buf, sec->prefix, sec->len);
+    strlwc(key, k->buf + sec->len, (unsigned)len + 1);
+    k->name = k->buf ;
+    k->hash = sec->fn(k->name);
+    k->fn   = sec->fn ;
+    return 0 ;
+}
 
-    dict = dictionary_new(0) ;
-    if (!dict) {
-        fclose(in);
-        return NULL ;
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Release the memory held by a key handle
+  @param    k   Key handle
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+void iniparser_key_free(iniparser_key_t * k)
+{
+    if (k==NULL) return ;
+    free(k->buf);
+    k->buf  = NULL ;
+    k->name = NULL ;
+    k->fn   = NULL ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Make sure a key handle holds the hash of its key for a dictionary
+  @param    d   Dictionary the key will be looked up in
+  @param    k   Key handle
+  @return   int 1 if k can be looked up by hash in d, 0 otherwise
+
+  Handles of mixed case literal keys only match dictionaries which ignore
+  case, callers fall back to the string functions for the others.
+ */
+/*--------------------------------------------------------------------------*/
+static int iniparser_key_ready(const dictionary * d, iniparser_key_t * k)
+{
+    dictionary_hash_fn  fn ;
+
+    if (k->buf==NULL && !(dictionary_flags(d) & DICTIONARY_NOCASE))
+        return 0 ;
+    fn = dictionary_hashfn(d);
+    if (k->fn!=fn) {
+        k->hash = fn(k->name);
+        k->fn   = fn ;
     }
+    return 1 ;
+}
 
-    memset(line,    0, ASCIILINESZ);
-    memset(section, 0, ASCIILINESZ);
-    memset(key,     0, ASCIILINESZ);
-    memset(val,     0, ASCIILINESZ);
-    last=0 ;
-
-    while (fgets(line+last, ASCIILINESZ-last, in)!=NULL) {
-        lineno++ ;
-        len = (int)strlen(line)-1;
-        if (len<=0)
-            continue;
-        /* Safety check against buffer overflows */
-        if (line[len]!='\n' && !feof(in)) {
-            iniparser_error_callback(
-              "iniparser: input line too long in %s (%d)\n",
-              ininame,
-              lineno);
-            dictionary_del(dict);
-            fclose(in);
-            return NULL ;
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a key handle
+  @param    d       Dictionary to search
+  @param    k       Key handle
+  @param    def     Default value to return if key not found.
+  @return   pointer to statically allocated character string
+ */
+/*--------------------------------------------------------------------------*/
+const char * iniparser_getstring_key(const dictionary * d, iniparser_key_t * k, const char * def)
+{
+    if (d==NULL || k==NULL || k->name==NULL)
+        return def ;
+    if (!iniparser_key_ready(d, k))
+        return iniparser_getstring(d, k->name, def);
+    return dictionary_get_hashed(d, k->name, k->hash, def);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the value of a key handle, convert to an int
+  @param    d Dictionary to search
+  @param    k Key handle
+  @param    notfound Value to return in case of error
+  @return   integer
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_getint_key(const dictionary * d, iniparser_key_t * k, int notfound)
+{
+    return (int)iniparser_getlongint_key(d, k, notfound);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the value of a key handle, convert to a long int
+  @param    d Dictionary to search
+  @param    k Key handle
+  @param    notfound Value to return in case of error
+  @return   long integer
+ */
+/*--------------------------------------------------------------------------*/
+long int iniparser_getlongint_key(const dictionary * d, iniparser_key_t * k, long int notfound)
+{
+    if (d==NULL || k==NULL || k->name==NULL)
+        return notfound ;
+    if (!iniparser_key_ready(d, k))
+        return iniparser_getlongint(d, k->name, notfound);
+    return dictionary_getlongint_hashed(d, k->name, k->hash, notfound);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the value of a key handle, convert to a double
+  @param    d Dictionary to search
+  @param    k Key handle
+  @param    notfound Value to return in case of error
+  @return   double
+ */
+/*--------------------------------------------------------------------------*/
+double iniparser_getdouble_key(const dictionary * d, iniparser_key_t * k, double notfound)
+{
+    if (d==NULL || k==NULL || k->name==NULL)
+        return notfound ;
+    if (!iniparser_key_ready(d, k))
+        return iniparser_getdouble(d, k->name, notfound);
+    return dictionary_getdouble_hashed(d, k->name, k->hash, notfound);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the value of a key handle, convert to a boolean
+  @param    d Dictionary to search
+  @param    k Key handle
+  @param    notfound Value to return in case of error
+  @return   integer
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_getboolean_key(const dictionary * d, iniparser_key_t * k, int notfound)
+{
+    if (d==NULL || k==NULL || k->name==NULL)
+        return notfound ;
+    if (!iniparser_key_ready(d, k))
+        return iniparser_getboolean(d, k->name, notfound);
+    return dictionary_getboolean_hashed(d, k->name, k->hash, notfound);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set the entry of a key handle in a dictionary.
+  @param    ini     Dictionary to modify.
+  @param    k       Key handle.
+  @param    val     New value to associate to the entry.
+  @return   int 0 if Ok, -1 otherwise.
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_set_key(dictionary * ini, iniparser_key_t * k, const char * val)
+{
+    if (ini==NULL || k==NULL || k->name==NULL)
+        return -1 ;
+    if (!iniparser_key_ready(ini, k))
+        return iniparser_set(ini, k->name, val);
+    return dictionary_set_hashed(ini, k->name, k->hash, val);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Update the marks of a line from the matches of a block
+  @param    p       Start of the block
+  @param    nl      Mask of the newlines of the block
+  @param    eq      Mask of the '=' of the block
+  @param    cm      Mask of the ';' and '#' of the block
+  @param    shift   Log2 of the number of mask bits per byte
+  @param    m       Marks to update
+  @return   1 if the block holds the end of the line, 0 if not
+
+  Masks have the lowest of the bits of a byte set for each byte which
+  matches, bytes being numbered from the lowest bits up.
+ */
+/*--------------------------------------------------------------------------*/
+static inline int ini_scan_block(
+    const char * p,
+    uint64_t nl,
+    uint64_t eq,
+    uint64_t cm,
+    unsigned shift,
+    ini_marks * m)
+{
+    if (nl) {
+        /* Only keep matches before the end of the line */
+        eq &= (nl & -nl) - 1 ;
+        cm &= (nl & -nl) - 1 ;
+    }
+    if (m->eq==NULL) {
+        if (eq==0)
+            return nl!=0 ;
+        m->eq = p + (__builtin_ctzll(eq) >> shift) ;
+        /* Comment markers only count after the '=' */
+        cm &= ~((eq & -eq) - 1) ;
+    }
+    if (m->cm==NULL && cm)
+        m->cm = p + (__builtin_ctzll(cm) >> shift) ;
+    return nl!=0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Scan a line one byte at a time
+  @param    p   Start of the line
+  @param    end End of the buffer
+  @param    m   Marks to fill in
+  @return   End of the line
+
+  Used for the tail of a buffer, too short for a whole block, and for
+  lines continuing in that tail, m already holding their first marks.
+ */
+/*--------------------------------------------------------------------------*/
+static const char * ini_scan_tail(const char * p, const char * end, ini_marks * m)
+{
+    for ( ; p<end && *p!='\n' ; p++) {
+        if (*p=='=' && m->eq==NULL)
+            m->eq = p ;
+        else if ((*p==';' || *p=='#') && m->eq && m->cm==NULL)
+            m->cm = p ;
+    }
+    return p ;
+}
+
+#if !defined(INI_SCAN_SSE2) && !defined(INI_SCAN_NEON)
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Match the bytes of an 8 bytes word against a character
+  @param    x   Word
+  @param    c   Character repeated in all bytes
+  @return   Mask with the high bit of each matching byte set
+
+  Exact, unlike the shorter zero byte tests which may also flag the byte
+  following a match.
+ */
+/*--------------------------------------------------------------------------*/
+static inline uint64_t ini_swar_eq(uint64_t x, uint64_t c)
+{
+    x ^= c ;
+    return ~(((x & INI_BYTES_7F) + INI_BYTES_7F) | x | INI_BYTES_7F) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Scanner working on 8 bytes words, for any platform
+ */
+/*--------------------------------------------------------------------------*/
+static const char * ini_scan_swar(const char * p, const char * end, ini_marks * m)
+{
+    uint64_t    x ;
+    uint64_t    mn ;
+
+    m->eq = m->cm = NULL ;
+    while (end - p >= 8) {
+        memcpy(&x, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        x = __builtin_bswap64(x);
+#endif
+        /* High bits of the bytes, moved down: 8 mask bits per byte */
+        mn = ini_swar_eq(x, '\n' * INI_BYTES_LO) >> 7 ;
+        if (ini_scan_block(p, mn,
+                ini_swar_eq(x, '=' * INI_BYTES_LO) >> 7,
+                (ini_swar_eq(x, ';' * INI_BYTES_LO) |
+                 ini_swar_eq(x, '#' * INI_BYTES_LO)) >> 7,
+                3, m))
+            return p + (__builtin_ctzll(mn) >> 3) ;
+        p += 8 ;
+    }
+    return ini_scan_tail(p, end, m);
+}
+#endif
+
+#ifdef INI_SCAN_SSE2
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Scanner working on 16 bytes blocks with SSE2
+ */
+/*--------------------------------------------------------------------------*/
+static const char * ini_scan_sse2(const char * p, const char * end, ini_marks * m)
+{
+    const __m128i   nl = _mm_set1_epi8('\n') ;
+    const __m128i   eq = _mm_set1_epi8('=') ;
+    const __m128i   sc = _mm_set1_epi8(';') ;
+    const __m128i   hs = _mm_set1_epi8('#') ;
+    __m128i         x ;
+    unsigned        mn ;
+
+    m->eq = m->cm = NULL ;
+    while (end - p >= 16) {
+        x  = _mm_loadu_si128((const __m128i*)p);
+        mn = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x, nl));
+        if (ini_scan_block(p, mn,
+                (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(x, eq)),
+                (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, sc),
+                                                         _mm_cmpeq_epi8(x, hs))),
+                0, m))
+            return p + __builtin_ctz(mn) ;
+        p += 16 ;
+    }
+    return ini_scan_tail(p, end, m);
+}
+#endif
+
+#ifdef INI_SCAN_AVX2
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Scanner working on 32 bytes blocks with AVX2
+
+  Compiled for AVX2 whatever the target of the rest of the file, and
+  only called once the processor is known to support it.
+ */
+/*--------------------------------------------------------------------------*/
+__attribute__((target("avx2")))
+static const char * ini_scan_avx2(const char * p, const char * end, ini_marks * m)
+{
+    const __m256i   nl = _mm256_set1_epi8('\n') ;
+    const __m256i   eq = _mm256_set1_epi8('=') ;
+    const __m256i   sc = _mm256_set1_epi8(';') ;
+    const __m256i   hs = _mm256_set1_epi8('#') ;
+    __m256i         x ;
+    unsigned        mn ;
+
+    m->eq = m->cm = NULL ;
+    while (end - p >= 32) {
+        x  = _mm256_loadu_si256((const __m256i*)p);
+        mn = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, nl));
+        if (ini_scan_block(p, mn,
+                (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, eq)),
+                (unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(x, sc),
+                                                               _mm256_cmpeq_epi8(x, hs))),
+                0, m))
+            return p + __builtin_ctz(mn) ;
+        p += 32 ;
+    }
+    return ini_scan_tail(p, end, m);
+}
+#endif
+
+#ifdef INI_SCAN_NEON
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Reduce a NEON byte comparison to a mask of 4 bits per byte
+ */
+/*--------------------------------------------------------------------------*/
+static inline uint64_t ini_neon_mask(uint8x16_t eq)
+{
+    return vget_lane_u64(vreinterpret_u64_u8(
+               vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0) & 0x1111111111111111ULL ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Scanner working on 16 bytes blocks with NEON
+ */
+/*--------------------------------------------------------------------------*/
+static const char * ini_scan_neon(const char * p, const char * end, ini_marks * m)
+{
+    uint8x16_t  x ;
+    uint64_t    mn ;
+
+    m->eq = m->cm = NULL ;
+    while (end - p >= 16) {
+        x  = vld1q_u8((const uint8_t*)p);
+        mn = ini_neon_mask(vceqq_u8(x, vdupq_n_u8('\n')));
+        if (ini_scan_block(p, mn,
+                ini_neon_mask(vceqq_u8(x, vdupq_n_u8('='))),
+                ini_neon_mask(vorrq_u8(vceqq_u8(x, vdupq_n_u8(';')),
+                                       vceqq_u8(x, vdupq_n_u8('#')))),
+                2, m))
+            return p + (__builtin_ctzll(mn) >> 2) ;
+        p += 16 ;
+    }
+    return ini_scan_tail(p, end, m);
+}
+#endif
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Pick the fastest scanner the processor supports
+  @return   Scanner to use
+ */
+/*--------------------------------------------------------------------------*/
+static ini_scan_fn ini_scan_select(void)
+{
+#if defined(INI_SCAN_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return ini_scan_avx2 ;
+#endif
+#if defined(INI_SCAN_SSE2)
+    return ini_scan_sse2 ;
+#elif defined(INI_SCAN_NEON)
+    return ini_scan_neon ;
+#else
+    return ini_scan_swar ;
+#endif
+}
+
+/** Scanner in use, set once by ini_scan_init() */
+static ini_scan_fn ini_scan ;
+static pthread_once_t ini_scan_once = PTHREAD_ONCE_INIT ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Select the scanner, through pthread_once()
+ */
+/*--------------------------------------------------------------------------*/
+static void ini_scan_init(void)
+{
+    ini_scan = ini_scan_select();
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Split a single line from an INI file into spans, in one pass
+  @param    line    Start of the line, may be concatenated multi-line input
+  @param    len     Length of the line, without its end of line
+  @param    sec     Output span of the section name
+  @param    key     Output span of the key
+  @param    val     Output span of the value
+  @param    m       Marks of the line, as found by the scanner
+  @return   line_status value
+
+  The line is classified and split in one forward scan, without copying
+  it: the spans point into line, blanks around section names, keys and
+  unquoted values are left out, and so are the quotes around a value.
+  Keys and section names keep their case. The scanner already found the
+  delimiters of the line: as they are not blanks, they lie within it
+  once stripped, and the first comment marker after the '=' is also the
+  first one after the blanks following it. A section line with an empty
+  name, "[]", leaves sec->p NULL, meaning that the current section does
+  not change.
+
+  The grammar is that of the sscanf() patterns this replaces: a value
+  is either quoted, keeping its blanks up to the closing quote or the
+  end of line, or runs up to a ';' or '#' comment. "" and '' are empty
+  values, and so is a missing one. Lines with no '=' after a non-empty
+  key are errors.
+ */
+/*--------------------------------------------------------------------------*/
+static line_status iniparser_tokenize(
+    char * line,
+    size_t len,
+    ini_span * sec,
+    ini_span * key,
+    ini_span * val,
+    const ini_marks * m)
+{
+    char    *   p = line ;
+    char    *   end = line + len ;
+    char    *   q ;
+    char    *   e ;
+
+    while (p<end && isspace((unsigned char)*p)) p++ ;
+    while (end>p && isspace((unsigned char)end[-1])) end-- ;
+    if (p==end) {
+        /* Empty line */
+        return LINE_EMPTY ;
+    }
+    if (*p=='#' || *p==';') {
+        /* Comment line */
+        return LINE_COMMENT ;
+    }
+    if (*p=='[' && end[-1]==']') {
+        /* Section name, up to the first ']' */
+        q = (char*)memchr(p+1, ']', (size_t)(end-p-1));
+        if (q==p+1) {
+            sec->p   = NULL ;
+            sec->len = 0 ;
+            return LINE_SECTION ;
+        }
+        p++ ;
+        while (p<q && isspace((unsigned char)*p)) p++ ;
+        while (q>p && isspace((unsigned char)q[-1])) q-- ;
+        sec->p   = p ;
+        sec->len = (size_t)(q-p) ;
+        return LINE_SECTION ;
+    }
+    /* Anything else needs a non-empty key before the first '=' */
+    q = (char*)m->eq ;
+    if (q==NULL || q==p) {
+        return LINE_ERROR ;
+    }
+    e = q ;
+    while (e>p && isspace((unsigned char)e[-1])) e-- ;
+    key->p   = p ;
+    key->len = (size_t)(e-p) ;
+
+    p = q+1 ;
+    while (p<end && isspace((unsigned char)*p)) p++ ;
+    if (p+1<end && (*p=='"' || *p=='\'') && p[1]!=*p) {
+        /* Quoted value, spaces kept, up to the closing quote if any */
+        q = (char*)memchr(p+1, *p, (size_t)(end-p-1));
+        val->p   = p+1 ;
+        val->len = (size_t)((q ? q : end) - (p+1)) ;
+        return LINE_VALUE ;
+    }
+    if (p<end && *p!=';' && *p!='#') {
+        /* Unquoted value, up to a comment */
+        q = m->cm ? (char*)m->cm : end ;
+        while (q>p && isspace((unsigned char)q[-1])) q-- ;
+        /* "" and '' are empty values */
+        if (q-p==2 && (*p=='"' || *p=='\'') && p[1]==*p)
+            q = p ;
+        val->p   = p ;
+        val->len = (size_t)(q-p) ;
+        return LINE_VALUE ;
+    }
+    /* Special cases: key=, key=; and key=# */
+    val->p   = p ;
+    val->len = 0 ;
+    return LINE_VALUE ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Release a file read by iniparser_load()
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_release(void * base, size_t len)
+{
+    (void)len ;
+    free(base);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Release a file mapped by iniparser_load_mmap()
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_unmap(void * base, size_t len)
+{
+    munmap(base, len);
+}
+
+static int iniparser_doc_line(
+    iniparser_doc_t * doc,
+    const char * key,
+    int sec,
+    size_t off,
+    size_t end,
+    size_t eq);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Store a parsed line in the dictionary of a chunk, or record it
+  @param    c       Chunk being parsed
+  @param    key     Section or "section:key", NULL for a syntax error
+  @param    val     Value, NULL for a section, or the line in error
+  @param    len     Length of the line in error
+  @param    lineno  Line number in the chunk
+  @return   void
+
+  The line is also mapped in the document of the chunk, if any, which
+  is all that is done without a dictionary.
+
+  A value not in buf, i.e. copied to tmp, is copied along with its key
+  when recorded. This only happens on the last line of buf, so that no
+  later record moves the copy.
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_emit(
+    ini_chunk * c,
+    const char * key,
+    const char * val,
+    size_t len,
+    int lineno)
+{
+    ini_entry   *   e ;
+    size_t          klen = 0 ;
+    size_t          vlen = 0 ;
+    int             copy ;
+
+    if (c->doc) {
+        if (key)
+            c->mem_err = iniparser_doc_line(c->doc, key, val==NULL,
+                                            c->loff, c->lend, c->leq);
+        if (c->mem_err || c->dict==NULL)
+            return ;
+    }
+    if (c->dict) {
+        if (key) {
+            c->mem_err = dictionary_set(c->dict, key, val);
+            return ;
+        }
+        iniparser_error_callback(
+          "iniparser: syntax error in %s (%d):\n-> %.*s\n",
+          c->name,
+          c->line0 + lineno,
+          (int)len,
+          val);
+        c->errs++ ;
+        return ;
+    }
+
+    if (c->n == c->nsize) {
+        e = (ini_entry*) realloc(c->ent, (c->nsize ? c->nsize * 2 : 256) * sizeof *e);
+        if (!e) {
+            c->mem_err = -1 ;
+            return ;
         }
-        /* Get rid of \n and spaces at end of line */
-        while ((len>=0) &&
-                ((line[len]=='\n') || (isspace(line[len])))) {
-            line[len]=0 ;
-            len-- ;
+        c->ent    = e ;
+        c->nsize  = c->nsize ? c->nsize * 2 : 256 ;
+    }
+    e = c->ent + c->n ;
+    e->key    = (size_t)-1 ;
+    e->val    = val ;
+    e->len    = len ;
+    e->lineno = lineno ;
+    if (key) {
+        copy = val && (val < c->buf || val >= c->buf + c->len) ;
+        klen = strlen(key) + 1 ;
+        vlen = copy ? strlen(val) + 1 : 0 ;
+        if (iniparser_reserve(&c->keys, &c->ksize, c->klen + klen + vlen) != 0) {
+            c->mem_err = -1 ;
+            return ;
         }
-        if (len < 0) { /* Line was entirely \n and/or spaces */
-            len = 0;
+        e->key  = c->klen ;
+        e->hash = c->fn(key) ;
+        memcpy(c->keys + c->klen, key, klen);
+        if (copy) {
+            e->val = c->keys + c->klen + klen ;
+            memcpy(c->keys + c->klen + klen, val, vlen);
         }
-        /* Detect multi-line */
-        if (line[len]=='\\') {
-            /* Multi-line value */
-            last=len ;
-            continue ;
-        } else {
-            last=0 ;
+        c->klen += klen + vlen ;
+    } else {
+        c->errs++ ;
+    }
+    c->n++ ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse a chunk of ini contents in place
+  @param    c   Chunk to parse
+  @return   void
+
+  Lines may be of any length. Multi-line values are joined by moving
+  their lines down over the backslashes, and values are NUL-terminated
+  where they end, over their closing quote, comment or end of line, so
+  that they need not be copied. Keys are, as they need their section
+  name in front. Parsing stops if memory runs out.
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_parse_chunk(ini_chunk * c)
+{
+    char    *   p = c->buf ;
+    char    *   end = c->buf + c->len ;
+    char    *   line ;
+    char    *   nl ;
+    char    *   e ;
+    char    *   w ;
+    size_t      seclen = 0 ;
+    ini_span    sec, key, val ;
+    ini_marks   m ;
+    ini_scan_fn scan ;
+
+    /* Chunks may be parsed by several threads at once */
+    pthread_once(&ini_scan_once, ini_scan_init);
+    scan = ini_scan ;
+
+    if (iniparser_reserve(&c->tmp, &c->tmpsize, 1) != 0) {
+        c->mem_err = -1 ;
+        return ;
+    }
+    /* Section name of the following keys, without the ':' */
+    c->tmp[0] = '\0' ;
+
+    while (p < end && c->mem_err == 0) {
+        /* Find the end of the line, joining lines ending with '\' */
+        line = p ;
+        w = NULL ;
+        for (;;) {
+            c->lines++ ;
+            nl = (char*)scan(p, end, &m);
+            e  = nl ;
+            while (e>p && isspace((unsigned char)e[-1])) e-- ;
+            if (w) {
+                memmove(w, p, (size_t)(e-p));
+                w += e-p ;
+            } else {
+                w = e ;
+            }
+            p = nl<end ? nl+1 : end ;
+            if (w==line || w[-1]!='\\')
+                break ;
+            w-- ;
+            if (p==end) {
+                /* A line continued past the end is dropped */
+                w = line ;
+                break ;
+            }
         }
-        switch (iniparser_line(line, section, key, val)) {
+        c->loff = (size_t)(line - c->buf) ;
+        c->lend = (size_t)(p - c->buf) ;
+        c->leq  = (w==e && m.eq) ? (size_t)(m.eq - c->buf) : (size_t)-1 ;
+        if (w!=e) {
+            /* Lines were joined, marks only describe the last one */
+            scan(line, w, &m);
+        }
+
+        switch (iniparser_tokenize(line, (size_t)(w-line), &sec, &key, &val, &m)) {
             case LINE_EMPTY:
             case LINE_COMMENT:
             break ;
 
             case LINE_SECTION:
-            mem_err = dictionary_set(dict, section, NULL);
+            if (sec.p) {
+                c->mem_err = iniparser_reserve(&c->tmp, &c->tmpsize, sec.len + 1);
+                if (c->mem_err)
+                    break ;
+                memcpy(c->tmp, sec.p, sec.len);
+                seclen = sec.len ;
+            }
+            c->tmp[seclen] = '\0' ;
+            iniparser_emit(c, c->tmp, NULL, 0, c->lines);
             break ;
 
             case LINE_VALUE:
-            sprintf(tmp, "%s:%s", section, key);
-            mem_err = dictionary_set(dict, tmp, val);
+            c->mem_err = iniparser_reserve(&c->tmp, &c->tmpsize,
+                                           seclen + key.len + val.len + 3);
+            if (c->mem_err)
+                break ;
+            c->tmp[seclen] = ':' ;
+            memcpy(c->tmp + seclen + 1, key.p, key.len);
+            c->tmp[seclen + 1 + key.len] = '\0' ;
+            if (val.p + val.len < end) {
+                /* Terminate the value in place, it is not copied */
+                val.p[val.len] = '\0' ;
+            } else {
+                /* No room left at the very end of buf: copy the value */
+                memcpy(c->tmp + seclen + key.len + 2, val.p, val.len);
+                val.p = c->tmp + seclen + key.len + 2 ;
+                val.p[val.len] = '\0' ;
+            }
+            iniparser_emit(c, c->tmp, val.p, 0, c->lines);
             break ;
 
             case LINE_ERROR:
-            iniparser_error_callback(
-              "iniparser: syntax error in %s (%d):\n-> %s\n",
-              ininame,
-              lineno,
-              line);
-            errs++ ;
+            iniparser_emit(c, NULL, line, (size_t)(w-line), c->lines);
             break;
 
             default:
             break ;
         }
-        memset(line, 0, ASCIILINESZ);
-        last=0;
-        if (mem_err<0) {
-            iniparser_error_callback("iniparser: memory allocation failure\n");
-            break ;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Store the entries recorded by a chunk in a dictionary
+  @param    d   Dictionary to fill in
+  @param    c   Chunk parsed without a dictionary, line0 set
+  @return   void
+
+  Entries are stored in the order of their lines, later ones overwriting
+  the values of earlier ones, as if the chunk had been parsed into d.
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_apply(dictionary * d, ini_chunk * c)
+{
+    const ini_entry *   e ;
+    size_t              i ;
+
+    for (i=0 ; i<c->n && c->mem_err==0 ; i++) {
+        e = c->ent + i ;
+        if (e->key != (size_t)-1) {
+            c->mem_err = dictionary_set_hashed(d, c->keys + e->key, e->hash, e->val);
+            continue ;
         }
+        iniparser_error_callback(
+          "iniparser: syntax error in %s (%d):\n-> %.*s\n",
+          c->name,
+          c->line0 + e->lineno,
+          (int)e->len,
+          e->val);
     }
-    if (errs) {
-        dictionary_del(dict);
-        dict = NULL ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Release the memory of a chunk, not its contents
+  @param    c   Chunk to release
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_chunk_free(ini_chunk * c)
+{
+    free(c->tmp);
+    free(c->keys);
+    free(c->ent);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Create an empty dictionary for ini contents
+  @param    buf     Contents the values will be parsed in, or NULL
+  @param    len     Size of the contents in bytes
+  @param    release Function releasing buf with the dictionary, or NULL
+  @return   Pointer to newly allocated dictionary, NULL on error
+
+  The dictionary borrows buf, which is released at once if empty, or if
+  the dictionary cannot be created.
+ */
+/*--------------------------------------------------------------------------*/
+static dictionary * iniparser_new(char * buf, size_t len, dictionary_release_fn release)
+{
+    dictionary * dict ;
+
+    dict = dictionary_new_flags(0, DICTIONARY_ARENA | DICTIONARY_NOCASE |
+                                DICTIONARY_SECTIONS) ;
+    if (!dict || len==0) {
+        if (release)
+            release(buf, len);
+        return dict ;
+    }
+    dictionary_borrow(dict, buf, len, release);
+    dictionary_reserve(dict, len / INI_BYTES_PER_ENTRY);
+    return dict ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse ini contents in place into a new dictionary
+  @param    buf     Contents, modified
+  @param    len     Size of the contents in bytes
+  @param    name    Name of the contents in error messages
+  @param    release Function releasing buf with the dictionary, or NULL
+  @return   Pointer to newly allocated dictionary, NULL on error
+
+  The dictionary borrows buf, which is released on error as well.
+ */
+/*--------------------------------------------------------------------------*/
+static dictionary * iniparser_parse(
+    char * buf,
+    size_t len,
+    const char * name,
+    dictionary_release_fn release)
+{
+    ini_chunk   c ;
+
+    memset(&c, 0, sizeof c);
+    c.buf  = buf ;
+    c.len  = len ;
+    c.name = name ;
+    c.dict = iniparser_new(buf, len, release);
+    if (!c.dict)
+        return NULL ;
+    iniparser_parse_chunk(&c);
+    iniparser_chunk_free(&c);
+    if (c.mem_err)
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+    if (c.errs) {
+        dictionary_del(c.dict);
+        return NULL ;
+    }
+    return c.dict ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Map an ini file in memory
+  @param    ininame Name of the ini file to read.
+  @param    buf     Set to a private copy-on-write mapping, NULL if empty
+  @param    len     Set to the size of the file
+  @return   0 if Ok, -1 after reporting an error
+ */
+/*--------------------------------------------------------------------------*/
+static int iniparser_map(const char * ininame, char ** buf, size_t * len)
+{
+    struct stat st ;
+    int         fd ;
+
+    if ((fd=open(ininame, O_RDONLY))<0) {
+        iniparser_error_callback("iniparser: cannot open %s\n", ininame);
+        return -1 ;
+    }
+    if (fstat(fd, &st)!=0) {
+        iniparser_error_callback("iniparser: cannot stat %s\n", ininame);
+        close(fd);
+        return -1 ;
+    }
+    *buf = NULL ;
+    *len = (size_t)st.st_size ;
+    if (st.st_size>0) {
+        *buf = (char*) mmap(NULL, *len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (*buf==MAP_FAILED) {
+            iniparser_error_callback("iniparser: cannot map %s\n", ininame);
+            close(fd);
+            return -1 ;
+        }
+    }
+    close(fd);
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find where to split ini contents between two chunks
+  @param    start   Start of the contents
+  @param    from    Start of the previous chunk
+  @param    at      Where to start looking
+  @param    end     End of the contents
+  @return   Start of the first section line after at, or end
+
+  A chunk must start with a line setting its section, not continuing
+  the line before. Lines following a line ending with '\' or blanks are
+  skipped, to be safe.
+ */
+/*--------------------------------------------------------------------------*/
+static char * iniparser_split(char * start, char * from, char * at, char * end)
+{
+    char    *   p = at > from ? at : from ;
+    char    *   nl ;
+    char    *   e ;
+
+    while (p < end && (nl = (char*)memchr(p, '\n', (size_t)(end-p))) != NULL) {
+        p = nl+1 ;
+        if (p>=end || *p!='[' || p+1>=end || p[1]==']')
+            continue ;
+        for (e=nl ; e>start && isspace((unsigned char)e[-1]) ; e--) ;
+        if (e>start && e[-1]=='\\')
+            continue ;
+        nl = (char*)memchr(p, '\n', (size_t)(end-p));
+        for (e = nl ? nl : end ; e>p && isspace((unsigned char)e[-1]) ; e--) ;
+        if (e[-1]==']')
+            return p ;
+    }
+    return end ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Thread of iniparser_load_parallel(), parses one chunk
+ */
+/*--------------------------------------------------------------------------*/
+static void * iniparser_worker(void * arg)
+{
+    iniparser_parse_chunk((ini_chunk*)arg);
+    return NULL ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Read a whole file into a buffer
+  @param    ininame Name of the file to read
+  @param    buf     Set to the contents, to free()
+  @param    len     Set to the size of the contents
+  @param    size    Set to the size of the buffer, more than len
+  @return   0 if Ok, -1 after reporting an error
+ */
+/*--------------------------------------------------------------------------*/
+static int iniparser_read(const char * ininame, char ** buf, size_t * len, size_t * size)
+{
+    FILE    *   in ;
+    struct stat st ;
+    char    *   t ;
+    size_t      n ;
+
+    if ((in=fopen(ininame, "r"))==NULL) {
+        iniparser_error_callback("iniparser: cannot open %s\n", ininame);
+        return -1 ;
+    }
+    /* Read the whole file in one go, growing the buffer if it was not
+       sized from the file size, e.g. for pipes */
+    *len  = 0 ;
+    *size = (fstat(fileno(in), &st)==0 && st.st_size>0) ?
+            (size_t)st.st_size + 1 : BUFSIZ ;
+    *buf  = (char*) malloc(*size);
+    while (*buf && (n = fread(*buf + *len, 1, *size - *len, in)) > 0) {
+        *len += n ;
+        if (*len == *size) {
+            t = (char*) realloc(*buf, *size * 2);
+            if (!t) {
+                free(*buf);
+                *buf = NULL ;
+                break ;
+            }
+            *buf   = t ;
+            *size *= 2 ;
+        }
+    }
+    if (*buf && ferror(in)) {
+        iniparser_error_callback("iniparser: cannot read %s\n", ininame);
+        free(*buf);
+        fclose(in);
+        return -1 ;
     }
     fclose(in);
+    if (!*buf) {
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+        return -1 ;
+    }
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse an ini file and return an allocated dictionary object
+  @param    ininame Name of the ini file to read.
+  @return   Pointer to newly allocated dictionary
+
+  This is the parser for ini files. This function is called, providing
+  the name of the file to be read. It returns a dictionary object that
+  should not be accessed directly, but through accessor functions
+  instead.
+
+  The file is read into a single buffer and parsed in place, which the
+  dictionary keeps for its values. Lines may be of any length, and so may
+  multi-line values, which are joined in place.
+
+  The returned dictionary must be freed using iniparser_freedict().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load(const char * ininame)
+{
+    char    *   buf ;
+    size_t      len ;
+    size_t      size ;
+
+    if (iniparser_read(ininame, &buf, &len, &size) != 0)
+        return NULL ;
+    return iniparser_parse(buf, len, ininame, iniparser_release);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse ini contents held in memory, in place
+  @param    buf     Contents of an ini file, modified by the parser.
+  @param    len     Size of the contents in bytes.
+  @return   Pointer to newly allocated dictionary
+
+  Same as iniparser_load(), parsing the caller's buffer instead of a
+  copy of a file: the returned dictionary refers to the values in buf,
+  which must stay valid and unchanged until iniparser_freedict(). Only
+  keys, which need their section name in front, are copied.
+
+  The returned dictionary must be freed using iniparser_freedict().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_mem(char * buf, size_t len)
+{
+    if (buf==NULL && len>0)
+        return NULL ;
+    return iniparser_parse(buf, len, "buffer", NULL);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse an ini file mapped in memory
+  @param    ininame Name of the ini file to read.
+  @return   Pointer to newly allocated dictionary
+
+  Same as iniparser_load(), reading the file through a private
+  copy-on-write mapping instead of copying it to a buffer. The file
+  itself is left unchanged, and the mapping is released by
+  iniparser_freedict().
+
+  The returned dictionary must be freed using iniparser_freedict().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_mmap(const char * ininame)
+{
+    char    *   buf ;
+    size_t      len ;
+
+    if (iniparser_map(ininame, &buf, &len) != 0)
+        return NULL ;
+    return iniparser_parse(buf, len, ininame, buf ? iniparser_unmap : NULL);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse an ini file with several threads
+  @param    ininame  Name of the ini file to read.
+  @param    nthreads Number of threads, or 0 for one per online processor,
+                     at most 64.
+  @return   Pointer to newly allocated dictionary
+
+  Same as iniparser_load_mmap(), the mapping being split into chunks at
+  section lines, one per thread but no smaller than 1 MB, so that small
+  files are parsed by the calling thread only. The calling thread parses
+  the first chunk into the dictionary while the others parse theirs
+  into lists of entries, which it then stores in file order: the
+  dictionary is the same as a sequential load would give, later values
+  of a key overwriting earlier ones.
+
+  The returned dictionary must be freed using iniparser_freedict().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_parallel(const char * ininame, int nthreads)
+{
+    dictionary  *   dict ;
+    ini_chunk   *   c ;
+    pthread_t   *   tid ;
+    char        *   started ;
+    char        *   buf ;
+    size_t          len ;
+    int             n ;
+    int             i ;
+    int             line0 ;
+    int             errs = 0 ;
+    int             mem_err = 0 ;
+
+    if (iniparser_map(ininame, &buf, &len) != 0)
+        return NULL ;
+    if (nthreads <= 0)
+        nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads <= 0)
+        nthreads = 1 ;
+    if (nthreads > INI_THREADS_MAX)
+        nthreads = INI_THREADS_MAX ;
+    n = (int)(len / INI_CHUNK_MIN < (size_t)nthreads ? len / INI_CHUNK_MIN : (size_t)nthreads) ;
+    c       = n>1 ? (ini_chunk*) calloc((size_t)n, sizeof *c) : NULL ;
+    tid     = n>1 ? (pthread_t*) calloc((size_t)n, sizeof *tid) : NULL ;
+    started = n>1 ? (char*) calloc((size_t)n, 1) : NULL ;
+    if (!c || !tid || !started) {
+        free(c);
+        free(tid);
+        free(started);
+        return iniparser_parse(buf, len, ininame, buf ? iniparser_unmap : NULL);
+    }
+    dict = iniparser_new(buf, len, iniparser_unmap);
+    if (!dict) {
+        free(c);
+        free(tid);
+        free(started);
+        return NULL ;
+    }
+
+    c[0].buf = buf ;
+    for (i=1 ; i<n ; i++) {
+        c[i].buf     = iniparser_split(buf, c[i-1].buf, buf + len * (size_t)i / (size_t)n,
+                                       buf + len);
+        c[i-1].len   = (size_t)(c[i].buf - c[i-1].buf) ;
+    }
+    c[n-1].len = (size_t)(buf + len - c[n-1].buf) ;
+    for (i=0 ; i<n ; i++) {
+        c[i].name = ininame ;
+        c[i].fn   = dictionary_hashfn(dict) ;
+        if (i>0 && c[i].len>0)
+            started[i] = pthread_create(&tid[i], NULL, iniparser_worker, &c[i])==0 ;
+    }
+
+    c[0].dict = dict ;
+    iniparser_parse_chunk(&c[0]);
+    line0   = c[0].lines ;
+    errs    = c[0].errs ;
+    mem_err = c[0].mem_err ;
+    for (i=1 ; i<n ; i++) {
+        c[i].line0 = line0 ;
+        if (started[i]) {
+            pthread_join(tid[i], NULL);
+            if (!mem_err)
+                iniparser_apply(dict, &c[i]);
+        } else if (!mem_err) {
+            /* No thread for this chunk: parse it here */
+            c[i].dict = dict ;
+            iniparser_parse_chunk(&c[i]);
+        }
+        line0   += c[i].lines ;
+        errs    += c[i].errs ;
+        mem_err |= c[i].mem_err ;
+    }
+    for (i=0 ; i<n ; i++)
+        iniparser_chunk_free(&c[i]);
+    free(c);
+    free(tid);
+    free(started);
+    if (mem_err)
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+    if (errs) {
+        dictionary_del(dict);
+        return NULL ;
+    }
     return dict ;
 }
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Write a whole buffer to a file descriptor
+  @param    fd      File descriptor to write to
+  @param    buf     Bytes to write
+  @param    len     Number of bytes
+  @return   0 if Ok, -1 on error
+ */
+/*--------------------------------------------------------------------------*/
+static int iniparser_write(int fd, const char * buf, size_t len)
+{
+    ssize_t n ;
+
+    while (len>0) {
+        n = write(fd, buf, len);
+        if (n<0) {
+            if (errno==EINTR)
+                continue ;
+            return -1 ;
+        }
+        buf += n ;
+        len -= (size_t)n ;
+    }
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Write a whole buffer to a file descriptor at an offset
+  @param    fd      File descriptor to write to
+  @param    buf     Bytes to write
+  @param    len     Number of bytes
+  @param    off     Offset in the file to write them at
+  @return   0 if Ok, -1 on error
+ */
+/*--------------------------------------------------------------------------*/
+static int iniparser_pwrite(int fd, const char * buf, size_t len, size_t off)
+{
+    ssize_t n ;
+
+    while (len>0) {
+        n = pwrite(fd, buf, len, (off_t)off);
+        if (n<0) {
+            if (errno==EINTR)
+                continue ;
+            return -1 ;
+        }
+        buf += n ;
+        len -= (size_t)n ;
+        off += (size_t)n ;
+    }
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Flush the directory holding a file to disk
+  @param    ininame Name of the file
+  @return   0 if Ok, -1 on error
+
+  Makes a rename into the directory durable.
+ */
+/*--------------------------------------------------------------------------*/
+static int iniparser_sync_dir(const char * ininame)
+{
+    const char  *   slash = strrchr(ininame, '/');
+    char        *   dir ;
+    int             fd ;
+    int             ret ;
+
+    if (slash==NULL) {
+        fd = open(".", O_RDONLY);
+    } else {
+        dir = (char*) malloc((size_t)(slash - ininame) + 2);
+        if (dir==NULL)
+            return -1 ;
+        /* Keep the slash of "/name" */
+        memcpy(dir, ininame, (size_t)(slash - ininame) + 1);
+        dir[slash > ininame ? slash - ininame : 1] = '\0' ;
+        fd = open(dir, O_RDONLY);
+        free(dir);
+    }
+    if (fd<0)
+        return -1 ;
+    ret = fsync(fd);
+    close(fd);
+    return ret ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Follow the symbolic links of a file name
+  @param    ininame Name of the file
+  @return   Allocated name of the file ininame refers to, NULL if out of memory
+
+  A name which is not a link, or does not exist, is returned as is.
+  Links relative to their directory are resolved against it, and at
+  most INI_LINKS_MAX links are followed.
+ */
+/*--------------------------------------------------------------------------*/
+static char * iniparser_resolve(const char * ininame)
+{
+    struct stat     st ;
+    char        *   name ;
+    char        *   target ;
+    char        *   slash ;
+    size_t          size ;
+    size_t          dlen ;
+    ssize_t         len ;
+    int             n ;
+
+    name = (char*) malloc(strlen(ininame) + 1);
+    if (name==NULL)
+        return NULL ;
+    strcpy(name, ininame);
+    for (n=0 ; n<INI_LINKS_MAX && lstat(name, &st)==0 && S_ISLNK(st.st_mode) ; n++) {
+        size   = st.st_size>0 ? (size_t)st.st_size + 1 : 4096 ;
+        slash  = strrchr(name, '/');
+        dlen   = slash ? (size_t)(slash - name) + 1 : 0 ;
+        target = (char*) malloc(dlen + size);
+        if (target==NULL) {
+            free(name);
+            return NULL ;
+        }
+        len = readlink(name, target + dlen, size);
+        if (len<0 || (size_t)len>=size) {
+            free(target);
+            break ;
+        }
+        target[dlen + (size_t)len] = '\0' ;
+        if (target[dlen]=='/')
+            memmove(target, target + dlen, (size_t)len + 1);
+        else
+            memcpy(target, name, dlen);
+        free(name);
+        name = target ;
+    }
+    return name ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Name the pending file of a file
+  @param    name    Name of the file, with its links resolved
+  @return   Allocated name of the pending file, NULL if out of memory
+
+  Saves with INIPARSER_SAVE_BATCH leave their contents in this file,
+  until iniparser_sync() moves it over the file. The name carries the
+  process id, so that the leftover of a process which crashed before
+  syncing is never mistaken for the last save of another one.
+ */
+/*--------------------------------------------------------------------------*/
+static char * iniparser_pending(const char * name)
+{
+    size_t      size = strlen(name) + 32 ;
+    char    *   pending ;
+
+    pending = (char*) malloc(size);
+    if (pending!=NULL)
+        snprintf(pending, size, "%s.%ld.pending", name, (long)getpid());
+    return pending ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Replace a file with new contents, atomically
+  @param    ininame Name of the file to replace
+  @param    buf     New contents
+  @param    len     Size of the new contents
+  @param    flags   0, or INIPARSER_SAVE_SYNC or INIPARSER_SAVE_BATCH,
+                    and INI_REPLACE_QUIET
+  @return   0 if Ok, -1 after reporting an error unless INI_REPLACE_QUIET
+
+  The contents are written in one go to a temporary file next to the
+  file ininame refers to, through symbolic links, and flushed to disk.
+  The temporary file then replaces that file by rename(): readers, and
+  crashes of the process or of the system, see either the old file or
+  the new one, never a truncated one. With INIPARSER_SAVE_SYNC the
+  rename is flushed as well. The temporary file takes the permissions
+  of the file it replaces.
+
+  With INIPARSER_SAVE_BATCH the temporary file is not flushed, and
+  replaces the pending file of this process instead, see
+  iniparser_pending(). Without it, the pending file is removed once
+  the file is replaced, as it holds older contents.
+ */
+/*--------------------------------------------------------------------------*/
+static int iniparser_replace(
+    const char * ininame,
+    const char * buf,
+    size_t len,
+    int flags)
+{
+    static unsigned seq ;
+    struct stat     st ;
+    char        *   name ;
+    char        *   tmp ;
+    char        *   pending ;
+    size_t          namelen ;
+    int             fd = -1 ;
+    int             tries ;
+    int          (* report)(const char *, ...) ;
+
+    report = (flags & INI_REPLACE_QUIET) ? quiet_error_callback :
+                                           iniparser_error_callback ;
+
+    /* Replace the file a link points to, not the link */
+    name = iniparser_resolve(ininame);
+    tmp  = name ? (char*) malloc(strlen(name) + 32) : NULL ;
+    if (tmp==NULL) {
+        report("iniparser: memory allocation failure\n");
+        free(name);
+        return -1 ;
+    }
+    namelen = strlen(name);
+    for (tries=0 ; fd<0 && tries<100 ; tries++) {
+        snprintf(tmp, namelen + 32, "%s.%ld.%u.tmp", name,
+                 (long)getpid(), __sync_fetch_and_add(&seq, 1));
+        fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL, 0666);
+        if (fd<0 && errno!=EEXIST)
+            break ;
+    }
+    if (fd<0) {
+        report("iniparser: cannot create %s\n", tmp);
+        free(tmp);
+        free(name);
+        return -1 ;
+    }
+    if (stat(name, &st)==0)
+        fchmod(fd, st.st_mode & 07777);
+
+    /* The data must be on disk before the rename can be, iniparser_sync()
+       flushes batches */
+    if (iniparser_write(fd, buf, len)!=0 ||
+        (!(flags & INIPARSER_SAVE_BATCH) && fdatasync(fd)!=0)) {
+        report("iniparser: cannot write %s\n", tmp);
+        close(fd);
+        goto fail ;
+    }
+    if (close(fd)!=0) {
+        report("iniparser: cannot write %s\n", tmp);
+        goto fail ;
+    }
+    pending = iniparser_pending(name);
+    if (pending==NULL) {
+        report("iniparser: memory allocation failure\n");
+        goto fail ;
+    }
+    if (flags & INIPARSER_SAVE_BATCH) {
+        if (rename(tmp, pending)!=0) {
+            report("iniparser: cannot rename %s to %s\n", tmp, pending);
+            free(pending);
+            goto fail ;
+        }
+        free(pending);
+        free(tmp);
+        free(name);
+        return 0 ;
+    }
+    if (rename(tmp, name)!=0) {
+        report("iniparser: cannot rename %s to %s\n", tmp, name);
+        free(pending);
+        goto fail ;
+    }
+    unlink(pending);
+    free(pending);
+    free(tmp);
+    if ((flags & INIPARSER_SAVE_SYNC) && iniparser_sync_dir(name)!=0) {
+        report("iniparser: cannot sync %s\n", name);
+        free(name);
+        return -1 ;
+    }
+    free(name);
+    return 0 ;
+
+fail:
+    unlink(tmp);
+    free(tmp);
+    free(name);
+    return -1 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Save a dictionary to an ini file, atomically
+  @param    d       Dictionary to save
+  @param    ininame Name of the ini file to write
+  @param    flags   0, INIPARSER_SAVE_SYNC or INIPARSER_SAVE_BATCH
+  @return   0 if Ok, -1 after reporting an error
+
+  The dictionary is rendered as by iniparser_dump_ini() to memory and
+  written to a temporary file next to ininame, which is flushed to disk
+  and then replaces ininame by rename(). If ininame is a symbolic link,
+  the file it points to is replaced. The temporary file takes the
+  permissions of the file it replaces.
+
+  Whether the process or the system crashes, ininame holds either its
+  old contents or the new ones, never a truncated file. With
+  INIPARSER_SAVE_SYNC, the directory is flushed too, so that the new
+  contents survive a power failure once this function returns. Without
+  it, a power failure may bring the old contents back until
+  iniparser_sync() is called.
+
+  With INIPARSER_SAVE_BATCH nothing is flushed and ininame is left as
+  it is: the new contents wait in a pending file next to it, named
+  after ininame and the process id, which each batch save replaces.
+  iniparser_sync() flushes that file and moves it over ininame, so that
+  a batch of saves pays for one flush of the file and one of the
+  directory. Until then, readers of ininame see the contents it had
+  before the batch, and a crash leaves the pending file behind. A save
+  without the flag drops the pending file of this process.
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_save(const dictionary * d, const char * ininame, int flags)
+{
+    ini_out o = { NULL, 0, 0, NULL, 0 } ;
+    int     ret ;
+
+    if (d==NULL || ininame==NULL)
+        return -1 ;
+
+    /* Render the whole file first, so that it is written at once */
+    iniparser_render(&o, d);
+    if (o.err) {
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+        free(o.buf);
+        return -1 ;
+    }
+    ret = iniparser_replace(ininame, o.buf, o.len, flags);
+    free(o.buf);
+    return ret ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Flush an ini file saved without INIPARSER_SAVE_SYNC to disk
+  @param    ininame Name of the ini file
+  @return   0 if Ok, -1 after reporting an error
+
+  Makes the last save of ininame durable. A save made with
+  INIPARSER_SAVE_BATCH is flushed from its pending file, which then
+  replaces ininame, otherwise ininame itself is flushed; the directory
+  holding it is flushed last. Call it once after a batch of saves, or
+  before exiting.
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_sync(const char * ininame)
+{
+    char    *   name ;
+    char    *   pending ;
+    int         fd ;
+    int         ret ;
+
+    if (ininame==NULL)
+        return -1 ;
+    if ((name=iniparser_resolve(ininame))==NULL) {
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+        return -1 ;
+    }
+    if ((pending=iniparser_pending(name))==NULL) {
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+        free(name);
+        return -1 ;
+    }
+    /* The last batch save is pending: flush it, then move it in place */
+    if ((fd=open(pending, O_RDONLY))>=0) {
+        ret = fdatasync(fd);
+        close(fd);
+        if (ret!=0 || rename(pending, name)!=0) {
+            iniparser_error_callback("iniparser: cannot sync %s\n", ininame);
+            goto fail ;
+        }
+    } else if (errno!=ENOENT || (fd=open(name, O_RDONLY))<0) {
+        iniparser_error_callback("iniparser: cannot open %s\n", ininame);
+        goto fail ;
+    } else {
+        ret = fsync(fd);
+        close(fd);
+        if (ret!=0) {
+            iniparser_error_callback("iniparser: cannot sync %s\n", ininame);
+            goto fail ;
+        }
+    }
+    if (iniparser_sync_dir(name)!=0) {
+        iniparser_error_callback("iniparser: cannot sync %s\n", ininame);
+        goto fail ;
+    }
+    free(pending);
+    free(name);
+    return 0 ;
+
+fail:
+    free(pending);
+    free(name);
+    return -1 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find the table bucket of a key in a document
+  @param    doc     Document to search, with a table
+  @param    key     Key to look for
+  @param    hash    Hash of key
+  @return   Bucket of the last line of key, or the empty one to put it in
+ */
+/*--------------------------------------------------------------------------*/
+static size_t iniparser_doc_bucket(
+    const iniparser_doc_t * doc,
+    const char * key,
+    unsigned hash)
+{
+    size_t      mask = doc->tsize - 1 ;
+    size_t      b ;
+    ssize_t     i ;
+
+    for (b=hash & mask ; (i=doc->table[b])>=0 ; b=(b+1) & mask) {
+        if (doc->lines[i].hash==hash &&
+            !strcasecmp(doc->keys + doc->lines[i].key, key))
+            break ;
+    }
+    return b ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Rebuild the table of a document with a new size
+  @param    doc     Document to index
+  @param    tsize   New size of the table, a power of 2
+  @return   0 if Ok, -1 if allocation failed, leaving the table as is
+ */
+/*--------------------------------------------------------------------------*/
+static int iniparser_doc_rehash(iniparser_doc_t * doc, size_t tsize)
+{
+    ssize_t *   table ;
+    size_t      i ;
+    size_t      b ;
+
+    table = (ssize_t*) malloc(tsize * sizeof *table);
+    if (!table)
+        return -1 ;
+    free(doc->table);
+    doc->table = table ;
+    doc->tsize = tsize ;
+    for (i=0 ; i<tsize ; i++)
+        table[i] = -1 ;
+    for (i=0 ; i<doc->n ; i++) {
+        b = iniparser_doc_bucket(doc, doc->keys + doc->lines[i].key,
+                                 doc->lines[i].hash);
+        doc->lines[i].prev = table[b] ;
+        table[b] = (ssize_t)i ;
+    }
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find where the value of a key line is in the document text
+  @param    doc     Document
+  @param    l       Key line, off and end set
+  @param    eq      Offset of its '='
+  @return   void
+
+  The value starts after the blanks following '=' and ends past its
+  closing quote, or at its last non-blank. It has room up to a comment
+  or the end of the line, which is where the tokenizer stops too.
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_doc_region(const iniparser_doc_t * doc, ini_line * l, size_t eq)
+{
+    const char  *   t = doc->text ;
+    const char  *   q ;
+    size_t          ce = l->end ;
+    size_t          p ;
+
+    if (ce>l->off && t[ce-1]=='\n') ce-- ;
+    if (ce>l->off && t[ce-1]=='\r') ce-- ;
+    for (p=eq+1 ; p<ce && isspace((unsigned char)t[p]) ; p++) ;
+    l->voff = p ;
+    l->vend = (size_t)-1 ;
+    if (p+1<ce && (t[p]=='"' || t[p]=='\'') && t[p+1]!=t[p]) {
+        q = (const char*) memchr(t+p+1, t[p], ce-p-1);
+        p = q ? (size_t)(q - t) + 1 : ce ;
+        l->vend = p ;
+    }
+    for (l->vmax=p ; l->vmax<ce && t[l->vmax]!=';' && t[l->vmax]!='#' ; l->vmax++) ;
+    if (l->vend==(size_t)-1) {
+        for (l->vend=l->vmax ; l->vend>l->voff &&
+             isspace((unsigned char)t[l->vend-1]) ; l->vend--) ;
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Map a key or section line of a document
+  @param    doc     Document, its text holding the line
+  @param    key     Section or "section:key"
+  @param    sec     Non-zero for a section line
+  @param    off     Start of the line
+  @param    end     End of the line, past its newline
+  @param    eq      Offset of its '=', (size_t)-1 if lines were joined
+  @return   0 if Ok, -1 if memory ran out
+
+  Lines must be mapped in file order.
+ */
+/*--------------------------------------------------------------------------*/
+static int iniparser_doc_line(
+    iniparser_doc_t * doc,
+    const char * key,
+    int sec,
+    size_t off,
+    size_t end,
+    size_t eq)
+{
+    ini_line    *   l ;
+    size_t          klen = strlen(key) + 1 ;
+    size_t          b ;
+
+    if (doc->n == doc->nsize) {
+        l = (ini_line*) realloc(doc->lines, (doc->nsize ? doc->nsize * 2 : 64) * sizeof *l);
+        if (!l)
+            return -1 ;
+        doc->lines = l ;
+        doc->nsize = doc->nsize ? doc->nsize * 2 : 64 ;
+    }
+    if ((doc->n + 1) * 2 > doc->tsize &&
+        iniparser_doc_rehash(doc, doc->tsize ? doc->tsize * 2 : 128) != 0)
+        return -1 ;
+    if (iniparser_reserve(&doc->keys, &doc->ksize, doc->klen + klen) != 0)
+        return -1 ;
+
+    l = doc->lines + doc->n ;
+    l->key  = doc->klen ;
+    l->name = 0 ;
+    if (!sec)
+        l->name = (doc->cur>=0 ? strlen(doc->keys + doc->lines[doc->cur].key) : 0) + 1 ;
+    l->hash = dictionary_hashfn(doc->dict)(key) ;
+    l->sec  = sec ;
+    l->dead = 0 ;
+    l->off  = off ;
+    l->end  = end ;
+    l->voff = l->vend = l->vmax = (size_t)-1 ;
+    l->last = end ;
+    l->gen  = 0 ;
+    memcpy(doc->keys + doc->klen, key, klen);
+    doc->klen += klen ;
+    if (!sec && eq!=(size_t)-1)
+        iniparser_doc_region(doc, l, eq);
+
+    b = iniparser_doc_bucket(doc, key, l->hash);
+    l->prev = doc->table[b] ;
+    doc->table[b] = (ssize_t)doc->n ;
+    if (sec)
+        doc->cur = (ssize_t)doc->n ;
+    else if (doc->cur>=0)
+        doc->lines[doc->cur].last = end ;
+    else
+        doc->top = end ;
+    doc->n++ ;
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Find the last line of a key in a document
+  @param    doc     Document to search
+  @param    key     Section or "section:key"
+  @return   Index of the line, -1 if not found
+ */
+/*--------------------------------------------------------------------------*/
+static ssize_t iniparser_doc_find(const iniparser_doc_t * doc, const char * key)
+{
+    ssize_t i ;
+
+    if (doc->tsize==0)
+        return -1 ;
+    i = doc->table[iniparser_doc_bucket(doc, key, dictionary_hashfn(doc->dict)(key))] ;
+    while (i>=0 && doc->lines[i].dead)
+        i = doc->lines[i].prev ;
+    return i ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Map all lines of a document again, from its text
+  @param    doc     Document
+  @return   0 if Ok, -1 if memory ran out, the document then being stale
+ */
+/*--------------------------------------------------------------------------*/
+static int iniparser_doc_map(iniparser_doc_t * doc)
+{
+    ini_chunk   c ;
+    size_t      i ;
+
+    doc->n    = 0 ;
+    doc->klen = 0 ;
+    doc->cur  = -1 ;
+    doc->top  = 0 ;
+    for (i=0 ; i<doc->tsize ; i++)
+        doc->table[i] = -1 ;
+
+    memset(&c, 0, sizeof c);
+    c.len  = doc->len ;
+    c.name = doc->name ;
+    c.doc  = doc ;
+    if (doc->len>0) {
+        /* The parser works in place */
+        c.buf = (char*) malloc(doc->len);
+        if (c.buf) {
+            memcpy(c.buf, doc->text, doc->len);
+            iniparser_parse_chunk(&c);
+            free(c.buf);
+        } else {
+            c.mem_err = -1 ;
+        }
+    }
+    iniparser_chunk_free(&c);
+    doc->stale = c.mem_err != 0 ;
+    return doc->stale ? -1 : 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Note an entry of a document as changed
+  @param    doc     Document
+  @param    entry   Entry changed
+  @return   void
+
+  If memory runs out, the next save checks all entries instead.
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_doc_touch(iniparser_doc_t * doc, const char * entry)
+{
+    size_t  len = strlen(entry) + 1 ;
+
+    if (doc->all)
+        return ;
+    if (iniparser_reserve(&doc->dirty, &doc->dsize, doc->dlen + len) != 0) {
+        doc->all = 1 ;
+        return ;
+    }
+    memcpy(doc->dirty + doc->dlen, entry, len);
+    doc->dlen += len ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Add an edit to the changes of a document
+  @param    s       Changes being gathered
+  @param    kind    Kind of edit
+  @param    off     Start of the bytes replaced
+  @param    end     End of the bytes replaced
+  @param    line    Line changed, or -1
+  @return   The new edit, with no text yet, or NULL if memory ran out
+ */
+/*--------------------------------------------------------------------------*/
+static ini_edit * iniparser_doc_edit(
+    ini_save * s,
+    ini_edit_kind kind,
+    size_t off,
+    size_t end,
+    ssize_t line)
+{
+    ini_edit    *   e ;
+
+    if (s->err)
+        return NULL ;
+    if (s->ne == s->nesize) {
+        e = (ini_edit*) realloc(s->ed, (s->nesize ? s->nesize * 2 : 16) * sizeof *e);
+        if (!e) {
+            s->err = 1 ;
+            return NULL ;
+        }
+        s->ed     = e ;
+        s->nesize = s->nesize ? s->nesize * 2 : 16 ;
+    }
+    e = s->ed + s->ne ;
+    e->kind = kind ;
+    e->off  = off ;
+    e->end  = end ;
+    e->txt  = s->etlen ;
+    e->len  = 0 ;
+    e->line = line ;
+    e->seq  = s->ne++ ;
+    e->key  = 0 ;
+    e->lead = 0 ;
+    e->eq   = (size_t)-1 ;
+    return e ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Append bytes to the text of the last edit
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_doc_put(ini_save * s, const char * p, size_t n)
+{
+    if (s->err || n==0)
+        return ;
+    if (iniparser_reserve(&s->et, &s->etsize, s->etlen + n) != 0) {
+        s->err = 1 ;
+        return ;
+    }
+    memcpy(s->et + s->etlen, p, n);
+    s->etlen += n ;
+    s->ed[s->ne-1].len += n ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Append a value to the text of the last edit, quoted if needed
+  @param    s   Changes being gathered
+  @param    v   Value, NULL for none
+  @return   void
+
+  Values with comment characters, outer blanks, a leading quote or a
+  trailing backslash are quoted, with whichever quote they do not hold.
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_doc_put_value(ini_save * s, const char * v)
+{
+    size_t  n = v ? strlen(v) : 0 ;
+    char    q = '"' ;
+
+    if (n>0 && (strpbrk(v, ";#") || isspace((unsigned char)v[0]) ||
+                isspace((unsigned char)v[n-1]) || v[n-1]=='\\' ||
+                v[0]=='"' || v[0]=='\'')) {
+        if (strchr(v, '"'))
+            q = strchr(v, '\'') ? 0 : '\'' ;
+    } else {
+        q = 0 ;
+    }
+    if (q)
+        iniparser_doc_put(s, &q, 1);
+    iniparser_doc_put(s, v, n);
+    if (q)
+        iniparser_doc_put(s, &q, 1);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Gather the edit of a changed entry of a document
+  @param    s       Changes being gathered
+  @param    key     Entry changed
+  @return   void
+
+  Lines of deleted keys are removed, values of changed keys replaced.
+  Keys new to the file are queued for iniparser_doc_inserts().
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_doc_visit(ini_save * s, const char * key)
+{
+    iniparser_doc_t *   doc = s->doc ;
+    ini_line        *   l ;
+    ini_edit        *   e ;
+    ini_new         *   nw ;
+    const char      *   v ;
+    const char      *   colon ;
+    ssize_t             li ;
+    ssize_t             i ;
+
+    li = iniparser_doc_find(doc, key);
+    v  = dictionary_get(doc->dict, key, INI_INVALID_KEY);
+    if (li<0) {
+        if (v==INI_INVALID_KEY)
+            return ;
+        if (s->nn == s->nnsize) {
+            nw = (ini_new*) realloc(s->nw, (s->nnsize ? s->nnsize * 2 : 16) * sizeof *nw);
+            if (!nw) {
+                s->err = 1 ;
+                return ;
+            }
+            s->nw     = nw ;
+            s->nnsize = s->nnsize ? s->nnsize * 2 : 16 ;
+        }
+        colon = strchr(key, ':');
+        nw = s->nw + s->nn ;
+        nw->key  = key ;
+        nw->slen = colon ? (size_t)(colon - key) : strlen(key) ;
+        nw->seq  = s->nn++ ;
+        return ;
+    }
+    l = doc->lines + li ;
+    if (l->gen==doc->gen || l->sec)
+        return ;
+    l->gen = doc->gen ;
+
+    if (v==INI_INVALID_KEY) {
+        /* Earlier lines of the key would come back: remove them all */
+        for (i=li ; i>=0 ; i=doc->lines[i].prev)
+            if (!doc->lines[i].dead)
+                iniparser_doc_edit(s, INI_EDIT_DELETE, doc->lines[i].off,
+                                   doc->lines[i].end, i);
+        return ;
+    }
+    if (l->voff!=(size_t)-1) {
+        e = iniparser_doc_edit(s, INI_EDIT_VALUE, l->voff, l->vend, li);
+        if (!e)
+            return ;
+        if (l->voff==l->vend && v[0] && doc->text[l->voff-1]=='=')
+            /* Empty value right after the equal sign: keep them apart */
+            iniparser_doc_put(s, " ", 1);
+        iniparser_doc_put_value(s, v);
+        e = s->ed + s->ne - 1 ;
+        if (!s->err && e->len==l->vend-l->voff &&
+            (e->len==0 || !memcmp(s->et + e->txt, doc->text + l->voff, e->len))) {
+            /* Unchanged */
+            s->etlen -= e->len ;
+            s->ne-- ;
+        }
+        return ;
+    }
+    /* Joined lines: rewrite as one */
+    e = iniparser_doc_edit(s, INI_EDIT_LINE, l->off, l->end, li);
+    if (!e)
+        return ;
+    e->eq = strlen(doc->keys + l->key + l->name) + 1 ;
+    iniparser_doc_put(s, doc->keys + l->key + l->name, e->eq - 1);
+    iniparser_doc_put(s, " = ", 3);
+    iniparser_doc_put_value(s, v);
+    if (doc->text[l->end-1]=='\n')
+        iniparser_doc_put(s, "\n", 1);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Add the edit inserting a line in a document
+  @param    s       Changes being gathered
+  @param    at      Where to insert the line
+  @param    key     Section or "section:key" of the line
+  @param    klen    Length of key
+  @param    name    Offset of the key name in key, 0 for a section
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_doc_insert(
+    ini_save * s,
+    size_t at,
+    const char * key,
+    size_t klen,
+    size_t name)
+{
+    const char  *   t = s->doc->text ;
+    ini_edit    *   e ;
+    size_t          lead ;
+
+    e = iniparser_doc_edit(s, INI_EDIT_INSERT, at, at, -1);
+    if (!e)
+        return ;
+    if (at>0 && t[at-1]!='\n' && !s->nl) {
+        /* Complete the last line first */
+        iniparser_doc_put(s, "\n", 1);
+        s->nl = 1 ;
+    }
+    if (name==0) {
+        iniparser_doc_put(s, "\n[", 2);
+        iniparser_doc_put(s, key, klen);
+        iniparser_doc_put(s, "]\n", 2);
+    } else {
+        iniparser_doc_put(s, key + name, klen - name);
+        iniparser_doc_put(s, " = ", 3);
+        iniparser_doc_put_value(s, dictionary_get(s->doc->dict, key, NULL));
+        iniparser_doc_put(s, "\n", 1);
+    }
+    if (s->err)
+        return ;
+    e = s->ed + s->ne - 1 ;
+    /* The line starts after any newline put before it */
+    lead = 0 ;
+    while (lead<e->len && s->et[e->txt + lead]=='\n')
+        lead++ ;
+    e->lead = lead ;
+    e->eq   = name ? klen - name + 1 : (size_t)-1 ;
+    /* Keep the key past the text, for mapping the line */
+    e->key  = s->etlen ;
+    if (iniparser_reserve(&s->et, &s->etsize, s->etlen + klen + 1) != 0) {
+        s->err = 1 ;
+        return ;
+    }
+    memcpy(s->et + s->etlen, key, klen);
+    s->et[s->etlen + klen] = '\0' ;
+    s->etlen += klen + 1 ;
+}
+
+/** qsort() order of new keys: by key, then by first change */
+static int iniparser_doc_cmp_key(const void * a, const void * b)
+{
+    const ini_new * x = (const ini_new*) a ;
+    const ini_new * y = (const ini_new*) b ;
+    int             c = strcasecmp(x->key, y->key) ;
+
+    if (c==0)
+        c = x->seq < y->seq ? -1 : x->seq > y->seq ;
+    return c ;
+}
+
+/** qsort() order of new keys: by section, then by first change */
+static int iniparser_doc_cmp_section(const void * a, const void * b)
+{
+    const ini_new * x = (const ini_new*) a ;
+    const ini_new * y = (const ini_new*) b ;
+    size_t          n = x->slen < y->slen ? x->slen : y->slen ;
+    int             c = strncasecmp(x->key, y->key, n) ;
+
+    if (c==0 && x->slen!=y->slen)
+        c = x->slen < y->slen ? -1 : 1 ;
+    if (c==0)
+        c = x->seq < y->seq ? -1 : x->seq > y->seq ;
+    return c ;
+}
+
+/** qsort() order of new keys: by first change of their section, then their own */
+static int iniparser_doc_cmp_group(const void * a, const void * b)
+{
+    const ini_new * x = (const ini_new*) a ;
+    const ini_new * y = (const ini_new*) b ;
+
+    if (x->gseq!=y->gseq)
+        return x->gseq < y->gseq ? -1 : 1 ;
+    return x->seq < y->seq ? -1 : x->seq > y->seq ;
+}
+
+/** Rank of edits at the same offset: a value ending there, like the last
+    line of a file without a final newline, then lines inserted there,
+    then the line starting there */
+static int iniparser_doc_rank(const ini_edit * e)
+{
+    return e->kind==INI_EDIT_VALUE ? 0 : e->kind==INI_EDIT_INSERT ? 1 : 2 ;
+}
+
+/** qsort() order of edits: by offset, then by rank, then by creation */
+static int iniparser_doc_cmp_edit(const void * a, const void * b)
+{
+    const ini_edit  * x = (const ini_edit*) a ;
+    const ini_edit  * y = (const ini_edit*) b ;
+
+    if (x->off!=y->off)
+        return x->off < y->off ? -1 : 1 ;
+    if (iniparser_doc_rank(x)!=iniparser_doc_rank(y))
+        return iniparser_doc_rank(x) < iniparser_doc_rank(y) ? -1 : 1 ;
+    return x->seq < y->seq ? -1 : x->seq > y->seq ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Gather the edits inserting the keys new to a document
+  @param    s       Changes being gathered, with new keys queued
+  @return   void
+
+  Keys go after the last line of their section in the file, or of the
+  lines before any section. Keys of sections not in the file go at its
+  end, grouped under a new section line, sections in the order they
+  were first changed.
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_doc_inserts(ini_save * s)
+{
+    iniparser_doc_t *   doc = s->doc ;
+    ini_new         *   nw ;
+    char            *   sname = NULL ;
+    size_t              ssize = 0 ;
+    size_t              i ;
+    size_t              j ;
+    ssize_t             si = -1 ;
+    int                 found = 0 ;
+    int                 pass ;
+
+    if (s->nn==0)
+        return ;
+    /* Drop keys changed more than once, then group keys by section */
+    qsort(s->nw, s->nn, sizeof *s->nw, iniparser_doc_cmp_key);
+    for (i=0, j=0 ; i<s->nn ; i++) {
+        if (j==0 || strcasecmp(s->nw[j-1].key, s->nw[i].key))
+            s->nw[j++] = s->nw[i] ;
+    }
+    s->nn = j ;
+    qsort(s->nw, s->nn, sizeof *s->nw, iniparser_doc_cmp_section);
+    for (i=0 ; i<s->nn ; i++) {
+        nw = s->nw + i ;
+        nw->gseq = (i>0 && nw->slen==nw[-1].slen &&
+                    !strncasecmp(nw->key, nw[-1].key, nw->slen)) ?
+                   nw[-1].gseq : nw->seq ;
+    }
+    qsort(s->nw, s->nn, sizeof *s->nw, iniparser_doc_cmp_group);
+
+    /* Sections of the file first, as the last one may end the file */
+    for (pass=0 ; pass<2 ; pass++) {
+        for (i=0 ; i<s->nn && !s->err ; i++) {
+            nw = s->nw + i ;
+            if (i==0 || nw->gseq!=nw[-1].gseq) {
+                /* First key of its section: find the section */
+                if (iniparser_reserve(&sname, &ssize, nw->slen + 1) != 0) {
+                    s->err = 1 ;
+                    break ;
+                }
+                memcpy(sname, nw->key, nw->slen);
+                sname[nw->slen] = '\0' ;
+                si = iniparser_doc_find(doc, sname);
+                found = (si>=0 && doc->lines[si].sec) || nw->slen==0 ;
+                if (found != (pass==0))
+                    continue ;
+                if (!found)
+                    iniparser_doc_insert(s, doc->len, sname, nw->slen, 0);
+            } else if (found != (pass==0)) {
+                continue ;
+            }
+            if (nw->key[nw->slen]=='\0')
+                continue ;
+            iniparser_doc_insert(s,
+                                 si>=0 && doc->lines[si].sec ? doc->lines[si].last :
+                                 nw->slen>0 ? doc->len : doc->top,
+                                 nw->key, strlen(nw->key), nw->slen + 1);
+        }
+    }
+    free(sname);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Write the edits of a document over its file
+  @param    s       Changes gathered, sorted
+  @param    flags   Flags of iniparser_doc_save()
+  @return   1 if written, 0 if they cannot be, -1 after reporting an error
+
+  Only possible if the file is the one read or last written, values fit
+  in their room, and lines are only inserted at the end of the file.
+  Each edit is one write of the same size as the bytes it replaces.
+ */
+/*--------------------------------------------------------------------------*/
+static int iniparser_doc_overwrite(ini_save * s, int flags)
+{
+    iniparser_doc_t *   doc = s->doc ;
+    ini_edit        *   e ;
+    ini_line        *   l ;
+    struct stat         st ;
+    char            *   buf = NULL ;
+    size_t              bsize = 0 ;
+    size_t              eof = doc->len ;
+    size_t              room ;
+    size_t              n ;
+    size_t              i ;
+    size_t              at ;
+    int                 fd ;
+
+    if (doc->stale || stat(doc->name, &st)!=0 ||
+        st.st_dev!=doc->st.st_dev || st.st_ino!=doc->st.st_ino ||
+        st.st_size!=doc->st.st_size ||
+        st.st_mtim.tv_sec!=doc->st.st_mtim.tv_sec ||
+        st.st_mtim.tv_nsec!=doc->st.st_mtim.tv_nsec)
+        return 0 ;
+    for (i=0 ; i<s->ne ; i++) {
+        e = s->ed + i ;
+        l = e->line>=0 ? doc->lines + e->line : NULL ;
+        if ((e->kind==INI_EDIT_VALUE && e->len > l->vmax - l->voff) ||
+            (e->kind==INI_EDIT_LINE && e->len > e->end - e->off) ||
+            (e->kind==INI_EDIT_INSERT && e->off!=doc->len))
+            return 0 ;
+    }
+
+    if ((fd=open(doc->name, O_WRONLY))<0)
+        return 0 ;
+    for (i=0 ; i<s->ne ; i++) {
+        e = s->ed + i ;
+        l = e->line>=0 ? doc->lines + e->line : NULL ;
+        /* Bytes written: the edit padded with blanks to its room */
+        switch (e->kind) {
+            case INI_EDIT_VALUE:
+            at   = l->voff ;
+            room = l->vmax - l->voff ;
+            n    = e->len ;
+            break ;
+            case INI_EDIT_LINE:
+            case INI_EDIT_DELETE:
+            at   = e->off ;
+            room = e->end - e->off ;
+            if (doc->text[e->end-1]=='\n')
+                room-- ;
+            n    = e->kind==INI_EDIT_LINE ? e->len - (doc->text[e->end-1]=='\n') : 0 ;
+            break ;
+            default:
+            /* After the lines inserted before */
+            at     = eof ;
+            room   = e->len ;
+            n      = e->len ;
+            e->off = e->end = eof ;
+            eof   += room ;
+            break ;
+        }
+        if (iniparser_reserve(&buf, &bsize, room) != 0) {
+            iniparser_error_callback("iniparser: memory allocation failure\n");
+            goto fail ;
+        }
+        if (n>0)
+            memcpy(buf, s->et + e->txt, n);
+        memset(buf + n, ' ', room - n);
+        if (iniparser_pwrite(fd, buf, room, at) != 0) {
+            iniparser_error_callback("iniparser: cannot write %s\n", doc->name);
+            goto fail ;
+        }
+        /* Keep the text as the file */
+        if (e->kind==INI_EDIT_INSERT && !doc->stale) {
+            if (iniparser_reserve(&doc->text, &doc->size, eof + 1) != 0) {
+                /* The map is behind the file now */
+                doc->stale = 1 ;
+                memset(&doc->st, 0, sizeof doc->st);
+            } else {
+                doc->len = eof ;
+            }
+        }
+        if (!doc->stale)
+            memcpy(doc->text + at, buf, room);
+    }
+    if (((flags & INIPARSER_SAVE_SYNC) && fsync(fd)!=0) || fstat(fd, &doc->st)!=0) {
+        iniparser_error_callback("iniparser: cannot sync %s\n", doc->name);
+        goto fail ;
+    }
+    close(fd);
+    free(buf);
+
+    /* Map the lines changed */
+    for (i=0 ; i<s->ne && !doc->stale ; i++) {
+        e = s->ed + i ;
+        l = e->line>=0 ? doc->lines + e->line : NULL ;
+        switch (e->kind) {
+            case INI_EDIT_VALUE:
+            l->vend = l->voff + e->len ;
+            break ;
+            case INI_EDIT_LINE:
+            iniparser_doc_region(doc, l, l->off + e->eq);
+            break ;
+            case INI_EDIT_DELETE:
+            l->dead = 1 ;
+            break ;
+            default:
+            if (iniparser_doc_line(doc, s->et + e->key, e->eq==(size_t)-1,
+                                   e->off + e->lead, e->off + e->len,
+                                   e->eq==(size_t)-1 ? e->eq :
+                                   e->off + e->lead + e->eq) != 0)
+                doc->stale = 1 ;
+            break ;
+        }
+    }
+    return 1 ;
+
+fail:
+    /* The file may be partly written, have it rewritten */
+    doc->stale = 1 ;
+    memset(&doc->st, 0, sizeof doc->st);
+    close(fd);
+    free(buf);
+    return -1 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Rewrite the file of a document with its edits
+  @param    s       Changes gathered, sorted
+  @param    flags   Flags of iniparser_doc_save()
+  @return   0 if Ok, -1 after reporting an error
+
+  Bytes around the edits are copied as they are, and the new file
+  replaces the old one as with iniparser_save().
+ */
+/*--------------------------------------------------------------------------*/
+static int iniparser_doc_rewrite(ini_save * s, int flags)
+{
+    iniparser_doc_t *   doc = s->doc ;
+    const ini_edit  *   e ;
+    char            *   buf ;
+    size_t              size = doc->len + 1 ;
+    size_t              len = 0 ;
+    size_t              pos = 0 ;
+    size_t              i ;
+
+    for (i=0 ; i<s->ne ; i++)
+        size += s->ed[i].len ;
+    buf = (char*) malloc(size);
+    if (!buf) {
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+        return -1 ;
+    }
+    for (i=0 ; i<s->ne ; i++) {
+        e = s->ed + i ;
+        memcpy(buf + len, doc->text + pos, e->off - pos);
+        len += e->off - pos ;
+        if (e->len>0)
+            memcpy(buf + len, s->et + e->txt, e->len);
+        len += e->len ;
+        pos = e->end ;
+    }
+    memcpy(buf + len, doc->text + pos, doc->len - pos);
+    len += doc->len - pos ;
+
+    if (iniparser_replace(doc->name, buf, len, flags) != 0) {
+        free(buf);
+        return -1 ;
+    }
+    free(doc->text);
+    doc->text = buf ;
+    doc->len  = len ;
+    doc->size = size ;
+    /* The file keeps older contents until a batch is synced, writing new
+       lines over it in place would mix the two */
+    if ((flags & INIPARSER_SAVE_BATCH) || stat(doc->name, &doc->st)!=0)
+        memset(&doc->st, 0, sizeof doc->st);
+    if (iniparser_doc_map(doc) != 0) {
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+        return -1 ;
+    }
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Load an ini file as a document
+  @param    ininame Name of the ini file to read.
+  @return   Newly allocated document, or NULL in case of error
+
+  The file is read once: the document keeps that text, and parses a
+  copy of it in place for its dictionary, mapping lines on the way.
+ */
+/*--------------------------------------------------------------------------*/
+iniparser_doc_t * iniparser_doc_load(const char * ininame)
+{
+    iniparser_doc_t *   doc ;
+    ini_chunk           c ;
+    size_t              len ;
+
+    if (ininame==NULL)
+        return NULL ;
+    doc = (iniparser_doc_t*) calloc(1, sizeof *doc);
+    len = strlen(ininame) + 1 ;
+    if (doc==NULL || (doc->name=(char*) malloc(len))==NULL) {
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+        free(doc);
+        return NULL ;
+    }
+    memcpy(doc->name, ininame, len);
+    doc->cur = -1 ;
+    if (iniparser_read(ininame, &doc->text, &doc->len, &doc->size) != 0) {
+        iniparser_doc_free(doc);
+        return NULL ;
+    }
+    if (stat(ininame, &doc->st)!=0)
+        memset(&doc->st, 0, sizeof doc->st);
+
+    memset(&c, 0, sizeof c);
+    c.len  = doc->len ;
+    c.name = doc->name ;
+    c.doc  = doc ;
+    c.buf  = (char*) malloc(doc->len + 1);
+    if (c.buf)
+        memcpy(c.buf, doc->text, doc->len);
+    c.dict = c.buf ? iniparser_new(c.buf, c.len, iniparser_release) : NULL ;
+    if (c.dict==NULL) {
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+        iniparser_doc_free(doc);
+        return NULL ;
+    }
+    doc->dict = c.dict ;
+    iniparser_parse_chunk(&c);
+    iniparser_chunk_free(&c);
+    if (c.mem_err)
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+    if (c.errs || c.mem_err) {
+        iniparser_doc_free(doc);
+        return NULL ;
+    }
+    return doc ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the dictionary of a document
+  @param    doc Document to read
+  @return   Dictionary of the document, owned by it
+ */
+/*--------------------------------------------------------------------------*/
+const dictionary * iniparser_doc_dict(const iniparser_doc_t * doc)
+{
+    return doc ? doc->dict : NULL ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set an entry of a document
+  @param    doc     Document to modify
+  @param    entry   Entry to modify (entry name)
+  @param    val     New value to associate to the entry
+  @return   int     0 if Ok, -1 otherwise
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_doc_set(iniparser_doc_t * doc, const char * entry, const char * val)
+{
+    if (doc==NULL || entry==NULL)
+        return -1 ;
+    if (iniparser_set(doc->dict, entry, val) != 0)
+        return -1 ;
+    iniparser_doc_touch(doc, entry);
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set an entry of a document through a key handle
+  @param    doc     Document to modify
+  @param    k       Handle of the entry
+  @param    val     New value to associate to the entry
+  @return   int     0 if Ok, -1 otherwise
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_doc_set_key(iniparser_doc_t * doc, iniparser_key_t * k, const char * val)
+{
+    if (doc==NULL || k==NULL || k->name==NULL)
+        return -1 ;
+    if (iniparser_set_key(doc->dict, k, val) != 0)
+        return -1 ;
+    iniparser_doc_touch(doc, k->name);
+    return 0 ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete an entry of a document
+  @param    doc     Document to modify
+  @param    entry   Entry to delete (entry name)
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+void iniparser_doc_unset(iniparser_doc_t * doc, const char * entry)
+{
+    if (doc==NULL || entry==NULL)
+        return ;
+    iniparser_unset(doc->dict, entry);
+    iniparser_doc_touch(doc, entry);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Save the changes made to a document to its file
+  @param    doc     Document to save
+  @param    flags   0, or INIPARSER_SAVE_SYNC or INIPARSER_SAVE_BATCH,
+                    and INIPARSER_SAVE_INPLACE
+  @return   0 if Ok, -1 after reporting an error
+
+  Only lines of entries set or deleted since the last save change, the
+  rest of the file is kept byte for byte. New keys go after the last
+  line of their section, new sections at the end of the file. The file
+  is rewritten as a whole and replaced atomically, as by iniparser_save().
+
+  With INIPARSER_SAVE_INPLACE, when new values fit in the room their
+  lines have for them, before a comment or the end of the line, deleted
+  lines can be blanked and new lines all go at the end of the file,
+  those bytes are written over the file in place instead, unless the
+  file changed since it was read. In place writes are not atomic: a
+  crash may leave the lines being written half written, and nothing
+  else.
+
+  Only the entries noted as changed are looked at, unless memory ran
+  out noting them: all entries of the dictionary and lines of the file
+  are then compared.
+
+  INIPARSER_SAVE_SYNC and INIPARSER_SAVE_BATCH have the same meaning
+  as for iniparser_save(). Batch saves always rewrite the file, and so
+  does the first save after them: its old contents no longer match the
+  document.
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_doc_save(iniparser_doc_t * doc, int flags)
+{
+    ini_save    s ;
+    size_t      i ;
+    int         ret ;
+
+    if (doc==NULL)
+        return -1 ;
+    if (doc->stale && iniparser_doc_map(doc) != 0) {
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+        return -1 ;
+    }
+    memset(&s, 0, sizeof s);
+    s.doc = doc ;
+    doc->gen++ ;
+    if (doc->all) {
+        for (i=0 ; i<(size_t)doc->dict->used ; i++)
+            if (doc->dict->key[i])
+                iniparser_doc_visit(&s, doc->dict->key[i]);
+        for (i=0 ; i<doc->n ; i++)
+            if (!doc->lines[i].dead)
+                iniparser_doc_visit(&s, doc->keys + doc->lines[i].key);
+    } else {
+        for (i=0 ; i<doc->dlen ; i+=strlen(doc->dirty + i) + 1)
+            iniparser_doc_visit(&s, doc->dirty + i);
+    }
+    iniparser_doc_inserts(&s);
+    if (s.err) {
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+        ret = -1 ;
+        goto done ;
+    }
+    if (s.ne>1)
+        qsort(s.ed, s.ne, sizeof *s.ed, iniparser_doc_cmp_edit);
+
+    ret = s.ne ? 0 : 1 ;
+    if (ret==0 && (flags & INIPARSER_SAVE_INPLACE) &&
+        !(flags & INIPARSER_SAVE_BATCH))
+        ret = iniparser_doc_overwrite(&s, flags);
+    if (ret==0)
+        ret = iniparser_doc_rewrite(&s, flags);
+    if (ret>=0) {
+        ret = 0 ;
+        doc->dlen = 0 ;
+        doc->all  = 0 ;
+    }
+done:
+    free(s.ed);
+    free(s.et);
+    free(s.nw);
+    return ret ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Free a document and its dictionary
+  @param    doc Document to free
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+void iniparser_doc_free(iniparser_doc_t * doc)
+{
+    if (doc==NULL)
+        return ;
+    dictionary_del(doc->dict);
+    free(doc->name);
+    free(doc->text);
+    free(doc->keys);
+    free(doc->lines);
+    free(doc->table);
+    free(doc->dirty);
+    free(doc);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Fill in the header of a compiled ini file
+  @param    h       Header to fill in
+  @param    ininame Name of the source file
+  @param    st      Status of the source file
+  @return   void
+
+  Sets all fields but block. Headers of the same source compare equal
+  with memcmp() up to block.
+ */
+/*--------------------------------------------------------------------------*/
+static void iniparser_cache_head(
+    ini_cache_head * h,
+    const char * ininame,
+    const struct stat * st)
+{
+    memset(h, 0, sizeof *h);
+    memcpy(h->magic, INI_CACHE_MAGIC, sizeof h->magic);
+    h->version = INI_CACHE_VERSION ;
+    h->order   = INI_CACHE_ORDER ;
+    h->dev     = (uint64_t)st->st_dev ;
+    h->ino     = (uint64_t)st->st_ino ;
+    h->size    = (uint64_t)st->st_size ;
+    h->mtime   = (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec ;
+    h->namelen = (uint32_t)((strlen(ininame) + 8) & ~(size_t)7) ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Map the cache of an ini file if it is up to date
+  @param    ininame   Name of the source file
+  @param    cachename Name of the cache file
+  @param    src       Status of the source file
+  @return   Compiled file, or NULL if the cache cannot be used
+
+  The cache is only trusted if it was written after the source was last
+  modified, as the source may have changed again within the resolution
+  of file times since.
+ */
+/*--------------------------------------------------------------------------*/
+static iniparser_compiled_t * iniparser_compiled_map(
+    const char * ininame,
+    const char * cachename,
+    const struct stat * src)
+{
+    iniparser_compiled_t    *   c ;
+    const ini_cache_head    *   h ;
+    ini_cache_head              want ;
+    struct stat                 st ;
+    void                    *   base ;
+    size_t                      len ;
+    int                         fd ;
+
+    if ((fd=open(cachename, O_RDONLY))<0)
+        return NULL ;
+    iniparser_cache_head(&want, ininame, src);
+    if (fstat(fd, &st)!=0 || (size_t)st.st_size < sizeof want + want.namelen ||
+        st.st_mtim.tv_sec < src->st_mtim.tv_sec ||
+        (st.st_mtim.tv_sec==src->st_mtim.tv_sec &&
+         st.st_mtim.tv_nsec<=src->st_mtim.tv_nsec)) {
+        close(fd);
+        return NULL ;
+    }
+    len  = (size_t)st.st_size ;
+    base = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base==MAP_FAILED)
+        return NULL ;
+
+    h = (const ini_cache_head*)base ;
+    c = (iniparser_compiled_t*) malloc(sizeof *c);
+    if (c==NULL ||
+        memcmp(h, &want, offsetof(ini_cache_head, block)) ||
+        len != sizeof want + want.namelen + h->block ||
+        memcmp(h + 1, ininame, strlen(ininame) + 1) ||
+        (c->f = dictionary_frozen_view((const char*)(h + 1) + want.namelen,
+                                       h->block)) == NULL) {
+        free(c);
+        munmap(base, len);
+        return NULL ;
+    }
+    c->base   = base ;
+    c->len    = len ;
+    c->mapped = 1 ;
+    return c ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compile an ini file and write its cache
+  @param    ininame   Name of the source file
+  @param    cachename Name of the cache file
+  @param    src       Status of the source file before it is read
+  @return   Compiled file, or NULL after reporting an error
+
+  The compiled file is built in memory and returned from there. The
+  cache is only written if the source did not change while it was
+  parsed, and not writing it is not an error.
+ */
+/*--------------------------------------------------------------------------*/
+static iniparser_compiled_t * iniparser_compiled_build(
+    const char * ininame,
+    const char * cachename,
+    const struct stat * src)
+{
+    iniparser_compiled_t    *   c ;
+    dictionary_frozen       *   f ;
+    dictionary              *   d ;
+    ini_cache_head          *   h ;
+    ini_cache_head              now ;
+    struct stat                 st ;
+    size_t                      len ;
+
+    if ((d=iniparser_load(ininame))==NULL)
+        return NULL ;
+    f = dictionary_freeze(d);
+    iniparser_freedict(d);
+
+    h = NULL ;
+    c = (iniparser_compiled_t*) malloc(sizeof *c);
+    if (f && c) {
+        iniparser_cache_head(&now, ininame, src);
+        len = sizeof now + now.namelen + dictionary_frozen_size(f) ;
+        h = (ini_cache_head*) calloc(1, len);
+    }
+    if (h==NULL) {
+        iniparser_error_callback("iniparser: memory allocation failure\n");
+        dictionary_frozen_del(f);
+        free(c);
+        return NULL ;
+    }
+    *h = now ;
+    h->block = (uint32_t)dictionary_frozen_size(f) ;
+    memcpy(h + 1, ininame, strlen(ininame));
+    memcpy((char*)(h + 1) + h->namelen, f, h->block);
+    dictionary_frozen_del(f);
+
+    c->f      = dictionary_frozen_view((char*)(h + 1) + h->namelen, h->block) ;
+    c->base   = h ;
+    c->len    = len ;
+    c->mapped = 0 ;
+
+    if (stat(ininame, &st)==0) {
+        iniparser_cache_head(&now, ininame, &st);
+        if (!memcmp(h, &now, offsetof(ini_cache_head, block)))
+            iniparser_replace(cachename, (const char*)h, len, INI_REPLACE_QUIET);
+    }
+    return c ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Load an ini file through its compiled cache
+  @param    ininame   Name of the ini file to read.
+  @param    cachename Name of the cache file, NULL for ininame + ".cache"
+  @return   Newly allocated compiled file, or NULL in case of error
+ */
+/*--------------------------------------------------------------------------*/
+iniparser_compiled_t * iniparser_load_compiled(
+    const char * ininame,
+    const char * cachename)
+{
+    iniparser_compiled_t    *   c ;
+    struct stat                 st ;
+    char                    *   name = NULL ;
+
+    if (ininame==NULL)
+        return NULL ;
+    if (stat(ininame, &st)!=0) {
+        iniparser_error_callback("iniparser: cannot open %s\n", ininame);
+        return NULL ;
+    }
+    if (cachename==NULL) {
+        name = (char*) malloc(strlen(ininame) + sizeof ".cache");
+        if (name==NULL) {
+            iniparser_error_callback("iniparser: memory allocation failure\n");
+            return NULL ;
+        }
+        strcpy(name, ininame);
+        strcat(name, ".cache");
+        cachename = name ;
+    }
+    c = iniparser_compiled_map(ininame, cachename, &st);
+    if (c==NULL)
+        c = iniparser_compiled_build(ininame, cachename, &st);
+    free(name);
+    return c ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a key in a compiled file
+  @param    c       Compiled file to search
+  @param    key     Key string to look for
+  @param    def     Default value to return if key not found.
+  @return   pointer to a string inside the compiled file
+
+  Same as iniparser_getstring(), for keys of any length. The returned
+  string stays valid until the compiled file is freed.
+ */
+/*--------------------------------------------------------------------------*/
+const char * iniparser_compiled_getstring(
+    const iniparser_compiled_t * c,
+    const char * key,
+    const char * def)
+{
+    if (c==NULL || key==NULL)
+        return def ;
+    /* Compiled from a DICTIONARY_NOCASE dictionary, which folds the key */
+    return dictionary_frozen_get(c->f, key, def);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a key in a compiled file,
+            convert to a long int
+  @param    c        Compiled file to search
+  @param    key      Key string to look for
+  @param    notfound Value to return in case of error
+  @return   long integer
+ */
+/*--------------------------------------------------------------------------*/
+long int iniparser_compiled_getlongint(
+    const iniparser_compiled_t * c,
+    const char * key,
+    long int notfound)
+{
+    const char * str = iniparser_compiled_getstring(c, key, INI_INVALID_KEY);
+
+    if (str==INI_INVALID_KEY || str==NULL)
+        return notfound ;
+    return strtol(str, NULL, 0);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a key in a compiled file,
+            convert to an int
+  @param    c        Compiled file to search
+  @param    key      Key string to look for
+  @param    notfound Value to return in case of error
+  @return   integer
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_compiled_getint(
+    const iniparser_compiled_t * c,
+    const char * key,
+    int notfound)
+{
+    return (int)iniparser_compiled_getlongint(c, key, notfound);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a key in a compiled file,
+            convert to a double
+  @param    c        Compiled file to search
+  @param    key      Key string to look for
+  @param    notfound Value to return in case of error
+  @return   double
+ */
+/*--------------------------------------------------------------------------*/
+double iniparser_compiled_getdouble(
+    const iniparser_compiled_t * c,
+    const char * key,
+    double notfound)
+{
+    const char * str = iniparser_compiled_getstring(c, key, INI_INVALID_KEY);
+
+    if (str==INI_INVALID_KEY || str==NULL)
+        return notfound ;
+    return atof(str);
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a key in a compiled file,
+            convert to a boolean
+  @param    c        Compiled file to search
+  @param    key      Key string to look for
+  @param    notfound Value to return in case of error
+  @return   integer
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_compiled_getboolean(
+    const iniparser_compiled_t * c,
+    const char * key,
+    int notfound)
+{
+    const char * str = iniparser_compiled_getstring(c, key, INI_INVALID_KEY);
+
+    if (str==INI_INVALID_KEY || str==NULL)
+        return notfound ;
+    if (str[0]=='y' || str[0]=='Y' || str[0]=='1' || str[0]=='t' || str[0]=='T')
+        return 1 ;
+    if (str[0]=='n' || str[0]=='N' || str[0]=='0' || str[0]=='f' || str[0]=='F')
+        return 0 ;
+    return notfound ;
+}
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Free a compiled ini file
+  @param    c   Compiled file to free
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+void iniparser_compiled_free(iniparser_compiled_t * c)
+{
+    if (c==NULL)
+        return ;
+    if (c->mapped)
+        munmap(c->base, c->len);
+    else
+        free(c->base);
+    free(c);
+}
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Free all memory associated to an ini dictionary
@@ -92,6 +92,9 @@ const char * iniparser_getsecname(const dictionary * d, int n);
 
   This function dumps a given dictionary into a loadable ini file.
   It is Ok to specify @c stderr or @c stdout as output files.
+
+  Sections and keys keep their order. The file is formatted in memory
+  in one pass over the entries and written with a single fwrite().
  */
 /*--------------------------------------------------------------------------*/
 
@@ -112,6 +115,61 @@ void iniparser_dump_ini(const dictionary * d, FILE * f);
 
 void iniparser_dumpsection_ini(const dictionary * d, const char * s, FILE * f);
 
+/** iniparser_save() flag: also flush the directory of the file to disk */
+#define INIPARSER_SAVE_SYNC 0x01
+
+/** iniparser_save() flag: leave the new contents pending, for
+    iniparser_sync() to flush and move over the file */
+#define INIPARSER_SAVE_BATCH 0x04
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Save a dictionary to an ini file, atomically
+  @param    d       Dictionary to save
+  @param    ininame Name of the ini file to write
+  @param    flags   0, INIPARSER_SAVE_SYNC or INIPARSER_SAVE_BATCH
+  @return   0 if Ok, -1 after reporting an error
+
+  The dictionary is rendered as by iniparser_dump_ini() to memory and
+  written to a temporary file next to ininame, which is flushed to disk
+  and then replaces ininame by rename(). If ininame is a symbolic link,
+  the file it points to is replaced. The temporary file takes the
+  permissions of the file it replaces.
+
+  Whether the process or the system crashes, ininame holds either its
+  old contents or the new ones, never a truncated file. With
+  INIPARSER_SAVE_SYNC, the directory is flushed too, so that the new
+  contents survive a power failure once this function returns. Without
+  it, a power failure may bring the old contents back until
+  iniparser_sync() is called.
+
+  With INIPARSER_SAVE_BATCH nothing is flushed and ininame is left as
+  it is: the new contents wait in a pending file next to it, named
+  after ininame and the process id, which each batch save replaces.
+  iniparser_sync() flushes that file and moves it over ininame, so that
+  a batch of saves pays for one flush of the file and one of the
+  directory. Until then, readers of ininame see the contents it had
+  before the batch, and a crash leaves the pending file behind. A save
+  without the flag drops the pending file of this process.
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_save(const dictionary * d, const char * ininame, int flags);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Flush an ini file saved without INIPARSER_SAVE_SYNC to disk
+  @param    ininame Name of the ini file
+  @return   0 if Ok, -1 after reporting an error
+
+  Makes the last save of ininame durable. A save made with
+  INIPARSER_SAVE_BATCH is flushed from its pending file, which then
+  replaces ininame, otherwise ininame itself is flushed; the directory
+  holding it is flushed last. Call it once after a batch of saves, or
+  before exiting.
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_sync(const char * ininame);
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Dump a dictionary to an opened file pointer.
@@ -198,6 +256,9 @@ const char * iniparser_getstring(const dictionary * d, const char * key, const c
   handling.
 
   Credits: Thanks to A. Becker for suggesting strtol()
+
+  The converted value is cached as by iniparser_getlongint(), which is
+  safe while other threads read the same dictionary.
  */
 /*--------------------------------------------------------------------------*/
 int iniparser_getint(const dictionary * d, const char * key, int notfound);
@@ -225,6 +286,11 @@ int iniparser_getint(const dictionary * d, const char * key, int notfound);
   Warning: the conversion may overflow in various ways. Conversion is
   totally outsourced to strtol(), see the associated man page for overflow
   handling.
+
+  The converted value is cached in the dictionary until the key is set
+  again, so repeated reads of a key do not parse its value again. The
+  cache is filled safely while other threads read the same dictionary,
+  as long as none of them modifies it.
  */
 /*--------------------------------------------------------------------------*/
 long int iniparser_getlongint(const dictionary * d, const char * key, long int notfound);
@@ -241,6 +307,9 @@ long int iniparser_getlongint(const dictionary * d, const char * key, long int n
   This function queries a dictionary for a key. A key as read from an
   ini file is given as "section:key". If the key cannot be found,
   the notfound value is returned.
+
+  The converted value is cached as by iniparser_getlongint(), which is
+  safe while other threads read the same dictionary.
  */
 /*--------------------------------------------------------------------------*/
 double iniparser_getdouble(const dictionary * d, const char * key, double notfound);
@@ -275,6 +344,9 @@ double iniparser_getdouble(const dictionary * d, const char * key, double notfou
 
   The notfound value returned if no boolean is identified, does not
   necessarily have to be 0 or 1.
+
+  The converted value is cached as by iniparser_getlongint(), which is
+  safe while other threads read the same dictionary.
  */
 /*--------------------------------------------------------------------------*/
 int iniparser_getboolean(const dictionary * d, const char * key, int notfound);
@@ -322,6 +394,115 @@ void iniparser_unset(dictionary * ini, const char * entry);
 /*--------------------------------------------------------------------------*/
 int iniparser_find_entry(const dictionary * ini, const char * entry) ;
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Key handle
+
+  A key handle names one "section:key" entry and remembers its hash, so
+  that looking it up again skips building, lowercasing and hashing the
+  key string. Handles for literal keys can be static:
+
+    static iniparser_key_t offset_key = INIPARSER_KEY("Subtitles:offset");
+
+  The hash is computed by the first lookup through the handle and kept
+  as long as the handle is used with dictionaries hashing keys the same
+  way. That first lookup writes to the handle: share a handle between
+  threads only once it has been used. C cannot hash strings at compile
+  time, so this lazy hash is the closest a static initializer can get.
+
+  Handles are only looked up without copying in dictionaries which
+  ignore case, such as those returned by iniparser_load(), or when the
+  handle comes from iniparser_section_key(). Otherwise the accessors
+  fall back to the string functions.
+ */
+/*--------------------------------------------------------------------------*/
+typedef struct _iniparser_key_ {
+    const char        * name ;  /** Full key name, "section:key" */
+    char              * buf ;   /** Allocated copy of name, or NULL */
+    unsigned            hash ;  /** Hash of name, valid if fn is set */
+    dictionary_hash_fn  fn ;    /** Hash function hash was computed with */
+} iniparser_key_t ;
+
+/** Static initializer of a key handle for a literal key name */
+#define INIPARSER_KEY(name)     { (name), NULL, 0, NULL }
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Section handle
+
+  Obtained once with iniparser_section(), a section handle builds key
+  handles for the keys of its section without repeating the section
+  name.
+ */
+/*--------------------------------------------------------------------------*/
+typedef struct _iniparser_section_ iniparser_section_t ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get a handle on a section of a dictionary
+  @param    d   Dictionary to search
+  @param    s   Section name
+  @return   Newly allocated section handle, or NULL in case of error
+
+  The section does not have to exist yet. Key handles made from the
+  returned handle are hashed for d right away. The handle must be freed
+  with iniparser_section_free().
+ */
+/*--------------------------------------------------------------------------*/
+iniparser_section_t * iniparser_section(const dictionary * d, const char * s);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Free a section handle
+  @param    sec Section handle to free
+  @return   void
+
+  Key handles made from the section stay valid.
+ */
+/*--------------------------------------------------------------------------*/
+void iniparser_section_free(iniparser_section_t * sec);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Build a key handle for a key of a section
+  @param    sec Section handle
+  @param    key Key name within the section
+  @param    k   Key handle to initialize
+  @return   int 0 if Ok, -1 otherwise
+
+  The handle holds a lowercase copy of "section:key", to be released
+  with iniparser_key_free().
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_section_key(const iniparser_section_t * sec, const char * key, iniparser_key_t * k);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Release the memory held by a key handle
+  @param    k   Key handle
+  @return   void
+
+  Does nothing for handles made with INIPARSER_KEY().
+ */
+/*--------------------------------------------------------------------------*/
+void iniparser_key_free(iniparser_key_t * k);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Accessors through key handles
+
+  Same as iniparser_getstring(), iniparser_getint(), iniparser_getlongint(),
+  iniparser_getdouble(), iniparser_getboolean() and iniparser_set(), with
+  the key given as a handle.
+ */
+/*--------------------------------------------------------------------------*/
+const char * iniparser_getstring_key(const dictionary * d, iniparser_key_t * k, const char * def);
+int iniparser_getint_key(const dictionary * d, iniparser_key_t * k, int notfound);
+long int iniparser_getlongint_key(const dictionary * d, iniparser_key_t * k, long int notfound);
+double iniparser_getdouble_key(const dictionary * d, iniparser_key_t * k, double notfound);
+int iniparser_getboolean_key(const dictionary * d, iniparser_key_t * k, int notfound);
+int iniparser_set_key(dictionary * ini, iniparser_key_t * k, const char * val);
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Parse an ini file and return an allocated dictionary object
@@ -333,11 +514,305 @@ int iniparser_find_entry(const dictionary * ini, const char * entry) ;
   should not be accessed directly, but through accessor functions
   instead.
 
+  The file is read into a single buffer and parsed in place, which the
+  dictionary keeps for its values. Lines may be of any length, and so may
+  multi-line values, which are joined in place.
+
+  The returned dictionary is created with DICTIONARY_NOCASE, so that
+  the accessor functions look keys up without copying them to lower
+  case first, and with DICTIONARY_SECTIONS, so that the section
+  functions only visit the entries they report.
+
   The returned dictionary must be freed using iniparser_freedict().
  */
 /*--------------------------------------------------------------------------*/
 dictionary * iniparser_load(const char * ininame);
 
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse ini contents held in memory, in place
+  @param    buf     Contents of an ini file, modified by the parser.
+  @param    len     Size of the contents in bytes.
+  @return   Pointer to newly allocated dictionary
+
+  Same as iniparser_load(), parsing the caller's buffer instead of a
+  copy of a file: the returned dictionary refers to the values in buf,
+  which must stay valid and unchanged until iniparser_freedict(). Only
+  keys, which need their section name in front, are copied.
+
+  The returned dictionary must be freed using iniparser_freedict().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_mem(char * buf, size_t len);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse an ini file mapped in memory
+  @param    ininame Name of the ini file to read.
+  @return   Pointer to newly allocated dictionary
+
+  Same as iniparser_load(), reading the file through a private
+  copy-on-write mapping instead of copying it to a buffer. The file
+  itself is left unchanged, and the mapping is released by
+  iniparser_freedict().
+
+  The returned dictionary must be freed using iniparser_freedict().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_mmap(const char * ininame);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Parse an ini file with several threads
+  @param    ininame  Name of the ini file to read.
+  @param    nthreads Number of threads, or 0 for one per online processor,
+                     at most 64.
+  @return   Pointer to newly allocated dictionary
+
+  Same as iniparser_load_mmap(), the mapping being split into chunks at
+  section lines, one per thread but no smaller than 1 MB, so that small
+  files are parsed by the calling thread only. The calling thread parses
+  the first chunk into the dictionary while the others parse theirs
+  into lists of entries, which it then stores in file order: the
+  dictionary is the same as a sequential load would give, later values
+  of a key overwriting earlier ones.
+
+  The returned dictionary must be freed using iniparser_freedict().
+ */
+/*--------------------------------------------------------------------------*/
+dictionary * iniparser_load_parallel(const char * ininame, int nthreads);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Ini document
+
+  An ini file loaded along with a map of its lines, so that saving it
+  only rewrites what changed, keeping its comments and layout. Read it
+  through iniparser_doc_dict(), change it through iniparser_doc_set()
+  and iniparser_doc_unset() only, which note what to save.
+ */
+/*--------------------------------------------------------------------------*/
+typedef struct _iniparser_doc_ iniparser_doc_t ;
+
+/** iniparser_doc_save() flag: write changes over the file in place when
+    they fit, rather than rewriting it atomically */
+#define INIPARSER_SAVE_INPLACE  0x02
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Load an ini file as a document
+  @param    ininame Name of the ini file to read.
+  @return   Newly allocated document, or NULL in case of error
+
+  Parses the file as iniparser_load() does, also keeping its contents
+  and where each key and section line is. Keeps twice the size of the
+  file in memory. The document must be freed with iniparser_doc_free().
+ */
+/*--------------------------------------------------------------------------*/
+iniparser_doc_t * iniparser_doc_load(const char * ininame);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the dictionary of a document
+  @param    doc Document to read
+  @return   Dictionary of the document, owned by it
+ */
+/*--------------------------------------------------------------------------*/
+const dictionary * iniparser_doc_dict(const iniparser_doc_t * doc);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set an entry of a document
+  @param    doc     Document to modify
+  @param    entry   Entry to modify (entry name)
+  @param    val     New value to associate to the entry
+  @return   int     0 if Ok, -1 otherwise
+
+  Same as iniparser_set() on the dictionary of the document, also
+  noting the entry for the next iniparser_doc_save().
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_doc_set(iniparser_doc_t * doc, const char * entry, const char * val);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Set an entry of a document through a key handle
+  @param    doc     Document to modify
+  @param    k       Handle of the entry
+  @param    val     New value to associate to the entry
+  @return   int     0 if Ok, -1 otherwise
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_doc_set_key(iniparser_doc_t * doc, iniparser_key_t * k, const char * val);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Delete an entry of a document
+  @param    doc     Document to modify
+  @param    entry   Entry to delete (entry name)
+  @return   void
+
+  Deleting a section does not delete its keys, nor its line.
+ */
+/*--------------------------------------------------------------------------*/
+void iniparser_doc_unset(iniparser_doc_t * doc, const char * entry);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Save the changes made to a document to its file
+  @param    doc     Document to save
+  @param    flags   0, or INIPARSER_SAVE_SYNC or INIPARSER_SAVE_BATCH,
+                    and INIPARSER_SAVE_INPLACE
+  @return   0 if Ok, -1 after reporting an error
+
+  Only lines of entries set or deleted since the last save change, the
+  rest of the file is kept byte for byte. New keys go after the last
+  line of their section, new sections at the end of the file. The file
+  is rewritten as a whole and replaced atomically, as by iniparser_save().
+
+  With INIPARSER_SAVE_INPLACE, when new values fit in the room their
+  lines have for them, before a comment or the end of the line, deleted
+  lines can be blanked and new lines all go at the end of the file,
+  those bytes are written over the file in place instead, unless the
+  file changed since it was read. In place writes are not atomic: a
+  crash may leave the lines being written half written, and nothing
+  else.
+
+  Only the entries noted as changed are looked at, unless memory ran
+  out noting them: all entries of the dictionary and lines of the file
+  are then compared.
+
+  INIPARSER_SAVE_SYNC and INIPARSER_SAVE_BATCH have the same meaning
+  as for iniparser_save(). Batch saves always rewrite the file, and so
+  does the first save after them: its old contents no longer match the
+  document.
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_doc_save(iniparser_doc_t * doc, int flags);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Free a document and its dictionary
+  @param    doc Document to free
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+void iniparser_doc_free(iniparser_doc_t * doc);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Compiled ini file
+
+  Read-only form of an ini file, made of a frozen dictionary of its
+  contents. Compiled files are stored in a cache file next to their
+  source, and loaded again from there without parsing.
+ */
+/*--------------------------------------------------------------------------*/
+typedef struct _iniparser_compiled_ iniparser_compiled_t ;
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Load an ini file through its compiled cache
+  @param    ininame   Name of the ini file to read.
+  @param    cachename Name of the cache file, NULL for ininame + ".cache"
+  @return   Newly allocated compiled file, or NULL in case of error
+
+  If the cache file was compiled from ininame as it is now, according
+  to its name, device, inode, size and modification time, it is mapped
+  in memory and used in place once its header and index are checked:
+  nothing is parsed, and nothing is allocated per key.
+
+  Otherwise the ini file is parsed as by iniparser_load(), compiled,
+  and the cache file replaced atomically with the result, which is
+  silently skipped if the cache cannot be written. Caches are specific
+  to the byte order of the machine and the version of this library,
+  and are compiled again if either differs.
+
+  Keys are looked up with the iniparser_compiled_get*() functions. The
+  compiled file must be freed with iniparser_compiled_free().
+ */
+/*--------------------------------------------------------------------------*/
+iniparser_compiled_t * iniparser_load_compiled(const char * ininame, const char * cachename);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a key in a compiled file
+  @param    c       Compiled file to search
+  @param    key     Key string to look for
+  @param    def     Default value to return if key not found.
+  @return   pointer to a string inside the compiled file
+
+  Same as iniparser_getstring(), for keys of any length. The returned
+  string stays valid until the compiled file is freed.
+ */
+/*--------------------------------------------------------------------------*/
+const char * iniparser_compiled_getstring(const iniparser_compiled_t * c, const char * key, const char * def);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a key in a compiled file,
+            convert to a long int
+  @param    c        Compiled file to search
+  @param    key      Key string to look for
+  @param    notfound Value to return in case of error
+  @return   long integer
+
+  Same as iniparser_getlongint(), without caching the conversion.
+ */
+/*--------------------------------------------------------------------------*/
+long int iniparser_compiled_getlongint(const iniparser_compiled_t * c, const char * key, long int notfound);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a key in a compiled file,
+            convert to an int
+  @param    c        Compiled file to search
+  @param    key      Key string to look for
+  @param    notfound Value to return in case of error
+  @return   integer
+
+  Same as iniparser_getint().
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_compiled_getint(const iniparser_compiled_t * c, const char * key, int notfound);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a key in a compiled file,
+            convert to a double
+  @param    c        Compiled file to search
+  @param    key      Key string to look for
+  @param    notfound Value to return in case of error
+  @return   double
+
+  Same as iniparser_getdouble().
+ */
+/*--------------------------------------------------------------------------*/
+double iniparser_compiled_getdouble(const iniparser_compiled_t * c, const char * key, double notfound);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Get the string associated to a key in a compiled file,
+            convert to a boolean
+  @param    c        Compiled file to search
+  @param    key      Key string to look for
+  @param    notfound Value to return in case of error
+  @return   integer
+
+  Same as iniparser_getboolean().
+ */
+/*--------------------------------------------------------------------------*/
+int iniparser_compiled_getboolean(const iniparser_compiled_t * c, const char * key, int notfound);
+
+/*-------------------------------------------------------------------------*/
+/**
+  @brief    Free a compiled ini file
+  @param    c   Compiled file to free
+  @return   void
+ */
+/*--------------------------------------------------------------------------*/
+void iniparser_compiled_free(iniparser_compiled_t * c);
+
 /*-------------------------------------------------------------------------*/
 /**
   @brief    Free all memory associated to an ini dictionary
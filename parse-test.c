@@ -0,0 +1,249 @@
+// Build command: gcc -O2 parse-test.c dictionary.c iniparser.c -o parse-test -lpthread
+
+/* Regression tests for the ini line tokenizer and the parallel loader.
+ *
+ * Each tokenizer case parses a few lines with iniparser_load_mem and
+ * checks the entries of the dictionary, in order, against the ones the
+ * former sscanf() parser gave. The parallel cases write a file large
+ * enough to be split between threads and check that
+ * iniparser_load_parallel gives the same dictionary as iniparser_load.
+ *
+ * Prints one line per failing case; the exit status is the number of
+ * failures. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "iniparser.h"
+
+struct parse_case
+{
+  const char *name;
+  const char *text;             /* Ini contents */
+  const char *expect;           /* "key=value\n" per entry, "key\n" for
+                                   sections, NULL for a syntax error */
+};
+
+static const struct parse_case cases[] = {
+  {"section and key",
+   "[a]\nk = v\n",
+   "a\na:k=v\n"},
+  {"blanks around names, no final newline",
+   "  [ a ]  \n  k  =  v  ",
+   "a\na:k=v\n"},
+  {"names lower-cased, values kept",
+   "[Sec]\nKey = Value\n",
+   "sec\nsec:key=Value\n"},
+  /* The sscanf() parser truncated the current section name to the
+   * length of the "[]" line minus one, the tokenizer keeps it */
+  {"empty section name keeps the section",
+   "[abc]\n[]\nk = 1\n",
+   "abc\nabc:k=1\n"},
+  {"first ']' ends the section name",
+   "[a]b]\nk = 1\n",
+   "a\na:k=1\n"},
+  {"comments and blank lines",
+   "; one\n# two\n   \n\t\n[a]\n  ; three\n",
+   "a\n"},
+  {"unquoted value up to a comment",
+   "[a]\nk = v w ; c\nl = x#c\n",
+   "a\na:k=v w\na:l=x\n"},
+  {"double quotes keep blanks and comment markers",
+   "[a]\nk = \"  x ; y # z  \"\n",
+   "a\na:k=  x ; y # z  \n"},
+  {"single quotes",
+   "[a]\nk = ' x '\n",
+   "a\na:k= x \n"},
+  {"text after the closing quote is dropped",
+   "[a]\nk = \"x\" y\n",
+   "a\na:k=x\n"},
+  {"unterminated quote runs to the end of line",
+   "[a]\nk = \"x y\n",
+   "a\na:k=x y\n"},
+  {"empty values",
+   "[a]\nk1 =\nk2 = \"\"\nk3 = ''\nk4 = ; c\nk5 = # c\n",
+   "a\na:k1=\na:k2=\na:k3=\na:k4=\na:k5=\n"},
+  {"'=' in the value",
+   "[a]\nk = x = y\n",
+   "a\na:k=x = y\n"},
+  {"CR LF line ends",
+   "[a]\r\nk = v\r\n",
+   "a\na:k=v\n"},
+  {"lines joined by a backslash",
+   "[a]\nk = x \\\n  y\nl = z\n",
+   "a\na:k=x   y\na:l=z\n"},
+  {"key before any section",
+   "k = v\n[a]\n",
+   ":k=v\na\n"},
+  {"later value wins",
+   "[a]\nk = 1\nk = 2\n",
+   "a\na:k=2\n"},
+  {"missing '='", "[a]\nk\n", NULL},
+  {"missing key", "[a]\n= v\n", NULL},
+};
+
+/* Renders the entries of d, NULL if d is */
+static char *
+render (const dictionary *d)
+{
+  static char buf[4096];
+  size_t n = 0;
+  ssize_t i;
+
+  if (!d)
+    return NULL;
+  buf[0] = '\0';
+  for (i = 0; i < d->size && n < sizeof buf; i++) {
+    if (!d->key[i])
+      continue;
+    if (d->val[i])
+      n += snprintf (buf + n, sizeof buf - n, "%s=%s\n", d->key[i],
+                     d->val[i]);
+    else
+      n += snprintf (buf + n, sizeof buf - n, "%s\n", d->key[i]);
+  }
+  return buf;
+}
+
+static int
+quiet (const char *fmt, ...)
+{
+  (void) fmt;
+  return 0;
+}
+
+static int
+run_case (const struct parse_case *c)
+{
+  size_t len = strlen (c->text);
+  char *buf = malloc (len + 1);
+  dictionary *d;
+  const char *text;
+  int failed;
+
+  if (!buf) {
+    printf ("%s: out of memory\n", c->name);
+    return 1;
+  }
+  memcpy (buf, c->text, len + 1);
+  d = iniparser_load_mem (buf, len);
+  text = render (d);
+  failed = c->expect ? !text || strcmp (text, c->expect) : text != NULL;
+  if (failed)
+    printf ("%s: parsed \"%s\"\n", c->name, text ? text : "(error)");
+  iniparser_freedict (d);
+  free (buf);
+  return failed;
+}
+
+/* Writes about size bytes of sections whose keys repeat across
+ * sections and within them, with all the line forms above */
+static int
+write_big (const char *path, size_t size, unsigned seed)
+{
+  FILE *f = fopen (path, "w");
+  size_t n = 0;
+  unsigned s = seed;
+  int i;
+
+  if (!f)
+    return -1;
+  while (n < size) {
+    s = s * 1103515245 + 12345;
+    n += fprintf (f, "[sec%u]\n", (s >> 8) % 5000);
+    for (i = 0; i < 20; i++) {
+      s = s * 1103515245 + 12345;
+      switch ((s >> 8) % 6) {
+      case 0:
+        n += fprintf (f, "key%u = value %u ; comment\n",
+                      (s >> 12) % 50, s);
+        break;
+      case 1:
+        n += fprintf (f, "key%u = \"quoted ; %u\"\n", (s >> 12) % 50, s);
+        break;
+      case 2:
+        n += fprintf (f, "key%u = first \\\n  second %u\n",
+                      (s >> 12) % 50, s);
+        break;
+      case 3:
+        n += fprintf (f, "# comment %u\n\n", s);
+        break;
+      case 4:
+        n += fprintf (f, "key%u =\n", (s >> 12) % 50);
+        break;
+      default:
+        n += fprintf (f, "Key%u = '%u'\r\n", (s >> 12) % 50, s);
+        break;
+      }
+    }
+  }
+  return fclose (f);
+}
+
+static int
+same (const dictionary *a, const dictionary *b)
+{
+  ssize_t i, j;
+
+  if (a->n != b->n)
+    return 0;
+  for (i = 0, j = 0; i < a->size && j < b->size; i++, j++) {
+    while (i < a->size && !a->key[i])
+      i++;
+    while (j < b->size && !b->key[j])
+      j++;
+    if (i == a->size || j == b->size)
+      return i == a->size && j == b->size;
+    if (strcmp (a->key[i], b->key[j])
+        || (a->val[i] == NULL) != (b->val[j] == NULL)
+        || (a->val[i] && strcmp (a->val[i], b->val[j])))
+      return 0;
+  }
+  return 1;
+}
+
+static int
+run_parallel (const char *path, unsigned seed, int nthreads)
+{
+  dictionary *d, *p;
+  int failed;
+
+  if (write_big (path, 8 << 20, seed)) {
+    printf ("parallel %u: cannot write\n", seed);
+    return 1;
+  }
+  d = iniparser_load (path);
+  p = iniparser_load_parallel (path, nthreads);
+  failed = !d || !p || !same (d, p);
+  if (failed)
+    printf ("parallel %u, %d threads: differs from iniparser_load\n",
+            seed, nthreads);
+  iniparser_freedict (d);
+  iniparser_freedict (p);
+  return failed;
+}
+
+int
+main (void)
+{
+  char path[] = "/tmp/parse-test-XXXXXX";
+  int fd = mkstemp (path);
+  size_t i;
+  int failed = 0;
+
+  if (fd < 0) {
+    perror ("mkstemp");
+    return 1;
+  }
+  close (fd);
+  iniparser_set_error_callback (quiet);
+  for (i = 0; i < sizeof cases / sizeof cases[0]; i++)
+    failed += run_case (&cases[i]);
+  failed += run_parallel (path, 1, 2);
+  failed += run_parallel (path, 2, 4);
+  failed += run_parallel (path, 3, 7);
+  unlink (path);
+  return failed;
+}
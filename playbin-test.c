@@ -21,6 +21,10 @@
 
 #define CONFIG_INI "config.ini"
 
+/* Configuration keys, hashed on first use */
+static iniparser_key_t subtitle_silent_key = INIPARSER_KEY ("Subtitles:silent");
+static iniparser_key_t subtitle_offset_key = INIPARSER_KEY ("Subtitles:offset");
+
 /* Copied from gst-plugins-base/gst/playback/gstplay-enum.h */
 typedef enum
 {
@@ -48,7 +52,7 @@ typedef struct _CustomData {
   GstState state;                 /* Current state of the pipeline */
   gint64 duration;                /* Duration of the clip, in nanoseconds */
 
-  dictionary *ini;
+  iniparser_doc_t *ini;           /* Config, loaded on the first change */
 
   gboolean subtitle_silent;
   gint subtitle_offset;
@@ -56,31 +60,6 @@ typedef struct _CustomData {
 
 static void analyze_streams (CustomData *data);
 
-int iniparser_save(dictionary * d, const char *inipath)
-{
-    int ret = 0;
-    FILE *fp = NULL;
-
-    if (inipath == NULL || d == NULL) {
-        ret = -1;
-        printf("saveConfig error:%d from (filepath == NULL || head == NULL)\n",ret);
-        return ret;
-    }
-
-    fp = fopen(inipath,"w");
-    if (fp == NULL) {
-        ret = -2;
-        printf("saveConfig:open file error:%d from %s\n",ret,inipath);
-        return ret;
-    }
-
-    iniparser_dump_ini(d,fp);
-
-    fclose(fp);
-
-    return 0;
-}
-
 /* This function is called when xxx */
 static void
 update_flag (GstElement * pipeline, GstPlayFlags flag, gboolean state)
@@ -176,13 +155,21 @@ static void subtitle_font_cb (GtkWidget *widget, CustomData *data) {
   analyze_streams(data);
 }
 
+/* Settings are read at startup from the compiled config, the config itself
+ * is only parsed once a setting changes */
+static iniparser_doc_t *config_doc (CustomData *data) {
+  if (!data->ini)
+    data->ini = iniparser_doc_load (CONFIG_INI);
+  return data->ini;
+}
+
 /* This function is called when the "subtitle silent menu item" is clicked */
 static void subtitle_silent_cb (GtkWidget *widget, CustomData *data) {
 
   data->subtitle_silent = !data->subtitle_silent;
 
-  iniparser_set (data->ini, "Subtitles:silent", data->subtitle_silent ? "TRUE" : "FALSE");
-  iniparser_save (data->ini, CONFIG_INI);
+  iniparser_doc_set_key (config_doc (data), &subtitle_silent_key, data->subtitle_silent ? "TRUE" : "FALSE");
+  iniparser_doc_save (data->ini, INIPARSER_SAVE_BATCH);
 
   g_print("%s called(silent:%s)\n", __func__, data->subtitle_silent ? "True" : "False");
 
@@ -199,8 +186,8 @@ static void subtitle_offset_forward_cb (GtkWidget *widget, CustomData *data) {
   data->subtitle_offset += 100;
 
   sprintf(offset_value, "%d", data->subtitle_offset);
-  iniparser_set (data->ini, "Subtitles:offset", offset_value);
-  iniparser_save (data->ini, CONFIG_INI);
+  iniparser_doc_set_key (config_doc (data), &subtitle_offset_key, offset_value);
+  iniparser_doc_save (data->ini, INIPARSER_SAVE_BATCH);
 
   g_print("%s called(offset:%d)\n", __func__, data->subtitle_offset);
 
@@ -217,8 +204,8 @@ static void subtitle_offset_backward_cb (GtkWidget *widget, CustomData *data) {
   data->subtitle_offset -= 100;
 
   sprintf(offset_value, "%d", data->subtitle_offset);
-  iniparser_set (data->ini, "Subtitles:offset", offset_value);
-  iniparser_save (data->ini, CONFIG_INI);
+  iniparser_doc_set_key (config_doc (data), &subtitle_offset_key, offset_value);
+  iniparser_doc_save (data->ini, INIPARSER_SAVE_BATCH);
 
   g_print("%s called(offset:%d)\n", __func__, data->subtitle_offset);
 
@@ -235,8 +222,8 @@ static void subtitle_offset_reset_cb (GtkWidget *widget, CustomData *data) {
   data->subtitle_offset = 0;
 
   sprintf(offset_value, "%d", data->subtitle_offset);
-  iniparser_set (data->ini, "Subtitles:offset", offset_value);
-  iniparser_save (data->ini, CONFIG_INI);
+  iniparser_doc_set_key (config_doc (data), &subtitle_offset_key, offset_value);
+  iniparser_doc_save (data->ini, INIPARSER_SAVE_BATCH);
 
   g_print("%s called(offset:%d)\n", __func__, data->subtitle_offset);
 
@@ -640,6 +627,7 @@ void create_config_ini_file(void)
 
 int main(int argc, char *argv[]) {
   CustomData data;
+  iniparser_compiled_t *config;
   GstStateChangeReturn ret;
   GstBus *bus;
 
@@ -661,10 +649,11 @@ int main(int argc, char *argv[]) {
 
   /* Initialize our data structure */
   memset (&data, 0, sizeof (data));
-  data.ini = iniparser_load(CONFIG_INI);
   data.duration = GST_CLOCK_TIME_NONE;
-  data.subtitle_silent = iniparser_getboolean (data.ini, "Subtitles:silent", FALSE);
-  data.subtitle_offset = iniparser_getint (data.ini, "Subtitles:offset", 0);
+  config = iniparser_load_compiled (CONFIG_INI, NULL);
+  data.subtitle_silent = iniparser_compiled_getboolean (config, subtitle_silent_key.name, FALSE);
+  data.subtitle_offset = iniparser_compiled_getint (config, subtitle_offset_key.name, 0);
+  iniparser_compiled_free (config);
 
   /* Create the elements */
   data.playbin = gst_element_factory_make ("playbin", "playbin");
@@ -711,5 +700,9 @@ int main(int argc, char *argv[]) {
   /* Free resources */
   gst_element_set_state (data.playbin, GST_STATE_NULL);
   gst_object_unref (data.playbin);
+
+  /* Settings are saved in a batch as they change, write the last one out */
+  iniparser_sync (CONFIG_INI);
+  iniparser_doc_free (data.ini);
   return 0;
 }